@@ -0,0 +1,153 @@
+#ifndef _ADMISSION_H_
+#define _ADMISSION_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "backend.h"
+
+// Limits the number of requests in flight and the size of their buffered
+// inputs. A request holds its share from the call until its body, and its
+// delayed continuation if it has one, have run.
+// Requests accepted in the `ADMISSION_QUEUE` mode wait in a FIFO backlog and
+// are handed to `launch`, in order, as the running requests release their share.
+class Admission {
+public:
+    typedef std::function<void()> Task;
+
+    explicit Admission(std::function<void(Task)> launch) : launch(std::move(launch)) {}
+
+    enum Outcome {
+        ADMITTED,
+        QUEUED,
+        REJECTED,
+    };
+
+    // 0 means no limit.
+    void set_limits(size_t max_requests, size_t max_bytes) {
+        std::vector<Task> started;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            this->max_requests = max_requests;
+            this->max_bytes = max_bytes;
+            start_queued(started);
+        }
+
+        cond.notify_all();
+        run_all(started);
+    }
+
+    // Admit a request whose inputs take `bytes` bytes. In the `QUEUED` outcome
+    // the task is moved into the backlog, otherwise it's left to the caller.
+    // The task must call `release` when done.
+    template<typename F>
+    Outcome acquire(size_t bytes, AdmissionPolicy policy, F& task) {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        if (backlog.empty() && fits(bytes)) {
+            take(bytes);
+            return ADMITTED;
+        }
+
+        switch (policy) {
+        case ADMISSION_BLOCK:
+            cond.wait(lock, [&]() { return backlog.empty() && fits(bytes); });
+            take(bytes);
+            return ADMITTED;
+
+        case ADMISSION_FAIL_FAST:
+            ++rejected;
+            return REJECTED;
+
+        case ADMISSION_QUEUE:
+        default:
+            backlog.push_back(Queued { bytes, Task(std::move(task)) });
+            return QUEUED;
+        }
+    }
+
+    void release(size_t bytes) {
+        std::vector<Task> started;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requests -= 1;
+            this->bytes -= bytes;
+            start_queued(started);
+        }
+
+        cond.notify_all();
+        run_all(started);
+    }
+
+    // Block until no request is in flight or queued.
+    void wait_idle() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&]() { return requests == 0 && backlog.empty(); });
+    }
+
+    void get(AdmissionStats* out) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        out->max_requests = max_requests;
+        out->max_bytes = max_bytes;
+        out->requests = requests;
+        out->bytes = bytes;
+        out->queued = backlog.size();
+        out->rejected = rejected;
+    }
+
+private:
+    struct Queued {
+        size_t bytes;
+        Task task;
+    };
+
+    // A request larger than `max_bytes` is still let through when nothing else
+    // is in flight, so it can't be stuck forever.
+    bool fits(size_t bytes) const {
+        return (max_requests == 0 || requests < max_requests)
+            && (max_bytes == 0 || this->bytes + bytes <= max_bytes || requests == 0);
+    }
+
+    void take(size_t bytes) {
+        requests += 1;
+        this->bytes += bytes;
+    }
+
+    // Must be called with `mutex` held. The tasks taken off the backlog are
+    // launched by the caller once the mutex is released.
+    void start_queued(std::vector<Task>& started) {
+        while (!backlog.empty() && fits(backlog.front().bytes)) {
+            take(backlog.front().bytes);
+            started.push_back(std::move(backlog.front().task));
+            backlog.pop_front();
+        }
+    }
+
+    void run_all(std::vector<Task>& started) {
+        for (auto& task : started) {
+            launch(std::move(task));
+        }
+    }
+
+    std::function<void(Task)> launch;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+
+    size_t max_requests = 0;
+    size_t max_bytes = 0;
+
+    size_t requests = 0;
+    size_t bytes = 0;
+    uint64_t rejected = 0;
+
+    std::deque<Queued> backlog;
+};
+
+#endif
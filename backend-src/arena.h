@@ -0,0 +1,166 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Bump allocator holding the state of one request: its copied inputs and the
+// task itself. Everything is released at once when the arena is recycled.
+// Allocations that don't fit in the inline block get a block of their own,
+// freed on recycling, so only unusually large inputs hit `malloc`.
+class Arena {
+public:
+    static const size_t BLOCK_SIZE = 4096;
+
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator = (const Arena&) = delete;
+
+    ~Arena() {
+        reset();
+    }
+
+    void* allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+        auto offset = (used + align - 1) & ~(align - 1);
+
+        if (offset + size <= BLOCK_SIZE) {
+            used = offset + size;
+            return block + offset;
+        }
+
+        auto large = (Large*) malloc(sizeof(Large) + size);
+        if (!large) {
+            throw std::bad_alloc();
+        }
+
+        large->next = larges;
+        larges = large;
+        large_size += size;
+
+        return large + 1;
+    }
+
+    template<typename T>
+    T* copy(const T* ptr, size_t len) {
+        auto output = (T*) allocate(len * sizeof(T), alignof(T));
+        if (len > 0) {
+            memcpy(output, ptr, len * sizeof(T));
+        }
+        return output;
+    }
+
+    char* copy(const char* str) {
+        return copy(str, strlen(str) + 1);
+    }
+
+    // Construct a `T` in the arena. Its destructor runs when the arena is reset.
+    template<typename T, typename... Args>
+    T* create(Args&&... args) {
+        auto output = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+
+        auto dtor = (Dtor*) allocate(sizeof(Dtor), alignof(Dtor));
+        dtor->object = output;
+        dtor->destroy = [](void* object) { ((T*) object)->~T(); };
+        dtor->next = dtors;
+        dtors = dtor;
+
+        return output;
+    }
+
+    // Number of bytes allocated so far.
+    size_t size() const {
+        return used + large_size;
+    }
+
+    void reset() {
+        // Detach the list first: a destructor may own the last reference to
+        // something that was allocated here.
+        auto dtor = dtors;
+        dtors = nullptr;
+
+        for (; dtor; dtor = dtor->next) {
+            dtor->destroy(dtor->object);
+        }
+
+        while (larges) {
+            auto next = larges->next;
+            free(larges);
+            larges = next;
+        }
+
+        used = 0;
+        large_size = 0;
+    }
+
+private:
+    struct Dtor {
+        void* object;
+        void (*destroy)(void*);
+        Dtor* next;
+    };
+
+    // Header of a block allocated for a single large allocation. Sized so the
+    // allocation that follows is aligned like `malloc`'s.
+    struct alignas(std::max_align_t) Large {
+        Large* next;
+    };
+
+    alignas(std::max_align_t) char block[BLOCK_SIZE];
+    size_t used = 0;
+    size_t large_size = 0;
+    Dtor* dtors = nullptr;
+    Large* larges = nullptr;
+};
+
+// Recycles arenas, so a request doesn't allocate one in the steady state. At
+// most `MAX_FREE` idle arenas are kept.
+class ArenaPool {
+public:
+    static const size_t MAX_FREE = 256;
+
+    ~ArenaPool() {
+        for (auto arena : free_arenas) {
+            delete arena;
+        }
+    }
+
+    Arena* acquire() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (!free_arenas.empty()) {
+                auto arena = free_arenas.back();
+                free_arenas.pop_back();
+                return arena;
+            }
+        }
+
+        return new Arena;
+    }
+
+    void release(Arena* arena) {
+        arena->reset();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (free_arenas.size() < MAX_FREE) {
+                free_arenas.push_back(arena);
+                return;
+            }
+        }
+
+        delete arena;
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<Arena*> free_arenas;
+};
+
+#endif
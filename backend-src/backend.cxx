@@ -1,15 +1,23 @@
+#include "admission.h"
+#include "arena.h"
 #include "backend.h"
+#include "completion_queue.h"
+#include "executor.h"
+#include "mapped_file.h"
+#include "random.h"
+#include "scan.h"
+#include "stats.h"
+#include "timer_wheel.h"
+#include "trace.h"
 
 #include <algorithm>
 #include <chrono>
-#include <iostream>
-#include <sstream>
+#include <cstring>
+#include <mutex>
+#include <system_error>
 #include <thread>
 #include <vector>
 
-using std::cout;
-using std::endl;
-
 FfiResult ok() {
     return FfiResult {
         .error_code = 0,
@@ -17,38 +25,361 @@ FfiResult ok() {
     };
 }
 
-template<typename F>
-void run(const char* name, F body) {
-    cout << "- C: " << name << "(): Start" << endl;
+// The executor is intentionally never destroyed implicitly: joining the workers
+// from a static destructor could block the process exit on a pending call.
+static std::mutex executor_mutex;
+static Executor* executor = nullptr;
+
+static Executor& get_executor() {
+    std::lock_guard<std::mutex> lock(executor_mutex);
+
+    if (!executor) {
+        executor = new Executor(0);
+    }
 
-    auto thread = std::thread([=]() {
-        cout << "- C: " << name << "(): New thread. Calling the callback..." << endl;
-        body();
-        cout << "- C: " << name << "(): Finished calling the callback. Exiting thread..." << endl;
+    return *executor;
+}
+
+static Admission admission([](Admission::Task task) {
+    get_executor().submit(std::move(task));
+});
+
+// Delayed tasks, handed to the executor when due. Never destroyed either.
+static TimerWheel& get_timers() {
+    static auto timers = new TimerWheel([](TimerWheel::Task task) {
+        get_executor().submit(std::move(task));
     });
 
-    thread.detach();
+    return *timers;
+}
+
+void backend_init(size_t num_threads) {
+    std::lock_guard<std::mutex> lock(executor_mutex);
+
+    if (!executor) {
+        executor = new Executor(num_threads);
+    }
+}
+
+void backend_shutdown() {
+    // Including the requests waiting on a timer, which would otherwise hand
+    // their continuation to a new executor. The timer thread may still be
+    // returning from submitting the last one.
+    admission.wait_idle();
+    get_timers().sync();
+
+    Executor* old = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(executor_mutex);
+        std::swap(old, executor);
+    }
+
+    delete old;
+
+    Tracer::get().flush();
+}
+
+bool backend_trace_open(const char* path) {
+    return Tracer::get().open(path);
+}
+
+static_assert(sizeof(Completion) == 64, "Completion layout is shared with the Java side");
+
+CompletionQueue* completion_queue_new(size_t capacity) {
+    return new CompletionQueue(capacity);
+}
+
+void completion_queue_free(CompletionQueue* queue) {
+    delete queue;
+}
+
+void completion_queue_push(CompletionQueue* queue,
+                           uint64_t request_id,
+                           const FfiResult* result,
+                           const void* payload,
+                           size_t payload_len)
+{
+    Completion completion;
+    completion.request_id = request_id;
+    completion.error_code = result->error_code;
+    completion.payload_len = (uint32_t) std::min(payload_len, sizeof(completion.payload));
+
+    if (completion.payload_len > 0) {
+        memcpy(completion.payload, payload, completion.payload_len);
+    }
+
+    queue->push(completion);
+}
+
+size_t completion_queue_poll(CompletionQueue* queue, Completion* out, size_t max) {
+    return queue->poll(out, max);
+}
+
+static Stats stats;
+
+// Operation the current thread is executing, so the callback phases reported by
+// the bindings can be attributed to it.
+thread_local size_t current_op = Stats::MAX_OPS;
+
+size_t backend_get_stats(OpStats* out, size_t max) {
+    return stats.collect(out, max);
+}
+
+void backend_record_callback_stat(StatsPhase phase, uint64_t ns) {
+    stats.record(current_op, phase, ns);
+}
+
+uint64_t backend_now_ns() {
+    return Stats::now_ns();
+}
+
+thread_local AdmissionPolicy admission_policy = ADMISSION_BLOCK;
+
+void backend_set_limits(size_t max_requests, size_t max_bytes) {
+    admission.set_limits(max_requests, max_bytes);
+}
+
+void backend_set_admission_policy(AdmissionPolicy policy) {
+    admission_policy = policy;
+}
+
+void backend_get_admission(AdmissionStats* out) {
+    admission.get(out);
+}
+
+FfiResult overloaded() {
+    return FfiResult {
+        .error_code = BACKEND_ERROR_OVERLOADED,
+        .error = (char*) "Too many calls in flight"
+    };
+}
+
+// Arguments passed, along with an error, to the callback of a rejected call.
+template<typename T> T empty() { return T(); }
+
+template<> const char* empty<const char*>() { return ""; }
+
+template<> const Key* empty<const Key*>() {
+    static const Key key = {};
+    return &key;
+}
+
+template<> const AppInfo* empty<const AppInfo*>() {
+    static const AppInfo app_info = { 0, (char*) "", {} };
+    return &app_info;
+}
+
+// Returns a function calling `o_cb` with the given error and empty arguments.
+template<typename... A>
+auto fail_with(void (*o_cb)(void*, const FfiResult*, A...), void* ctx) {
+    return [=](const FfiResult* result) {
+        o_cb(ctx, result, empty<A>()...);
+    };
+}
+
+// Never destroyed: requests may still complete while static destructors run.
+static ArenaPool& arenas = *new ArenaPool;
+
+struct RequestState {
+    const char* name;
+    size_t op;
+    Arena* arena;
+    // Size of the inputs held in the arena.
+    size_t bytes;
+    uint64_t submitted;
+};
+
+template<typename F>
+struct Request {
+    RequestState state;
+    F body;
+};
+
+// The request whose body is running on this thread. Null once the body has
+// taken it over with `keep`.
+thread_local RequestState* current_request = nullptr;
+
+// Release what the request holds: its arena and its admission share.
+void finish(RequestState* request) {
+    auto bytes = request->bytes;
+    arenas.release(request->arena);
+    admission.release(bytes);
 }
 
-void print_key(std::ostream& s, const Key& key) {
-    cout << "[";
-    for (auto b : key.bytes) {
-        cout << (int) b << ", ";
+// Run `body` on the executor, once admitted. The inputs the call holds on to
+// must be copied into `arena`, which then also stores the body. It's recycled
+// once the body has run. `reject` reports the error if the call is rejected.
+template<typename F, typename R>
+void run(const char* name, Arena* arena, R reject, F body) {
+    static const size_t op = stats.op(name);
+
+    TRACE_DEBUG("{s}(): Start", name);
+
+    auto request = arena->create<Request<F>>(Request<F> {
+        RequestState { name, op, arena, arena->size(), Stats::now_ns() },
+        std::move(body)
+    });
+
+    // Captures a single pointer, so wrapping it in a `std::function` doesn't
+    // allocate either.
+    auto task = [request]() {
+        auto state = &request->state;
+        // Read up front: a kept request may be finished, with `state` gone,
+        // by the time the body returns.
+        auto op_name = state->name;
+        auto started = Stats::now_ns();
+
+        stats.count(op);
+        stats.record(op, STATS_QUEUE, started - state->submitted);
+
+        TRACE_DEBUG("{s}(): On worker thread. Calling the callback...", op_name);
+
+        current_op = op;
+        current_request = state;
+        request->body();
+        auto kept = current_request == nullptr;
+        current_request = nullptr;
+        current_op = Stats::MAX_OPS;
+
+        stats.record(op, STATS_EXECUTE, Stats::now_ns() - started);
+
+        TRACE_DEBUG("{s}(): Finished calling the callback.", op_name);
+
+        // Otherwise the request may be finished already.
+        if (!kept) {
+            finish(state);
+        }
+    };
+
+    auto policy = admission_policy;
+    if (policy == ADMISSION_BLOCK && current_op != Stats::MAX_OPS) {
+        policy = ADMISSION_QUEUE;
+    }
+
+    switch (admission.acquire(request->state.bytes, policy, task)) {
+    case Admission::ADMITTED:
+        get_executor().submit(std::move(task));
+        break;
+
+    case Admission::QUEUED:
+        TRACE_DEBUG("{s}(): Queued", name);
+        break;
+
+    case Admission::REJECTED: {
+        TRACE_INFO("{s}(): Rejected, too many calls in flight", name);
+
+        auto result = overloaded();
+        reject(&result);
+        arenas.release(arena);
+        break;
+    }
     }
-    cout << "]";
 }
 
-void print_app_info(std::ostream& s, const AppInfo& app_info) {
-        cout << "{ id: " << app_info.id
-             << ", name: " << app_info.name
-             << ", key: ";
-        print_key(cout, app_info.key);
-        cout << "}";
+// For calls that don't hold on to any input.
+template<typename F, typename R>
+void run(const char* name, R reject, F body) {
+    run(name, arenas.acquire(), reject, std::move(body));
 }
 
+// Called from a request body (or continuation): take over the request, which
+// then stays in flight, with its arena and admission share, after the body
+// returns, until it's passed to `finish`.
+RequestState* keep() {
+    auto request = current_request;
+    current_request = nullptr;
+    return request;
+}
+
+// Called from a request body: run `body` on the executor after `delay`, as a
+// continuation of the request. The request stays in flight until the
+// continuation has run, but holds no thread while waiting. The continuation
+// can in turn `keep` the request or continue it again.
+template<typename F>
+void continue_after(std::chrono::nanoseconds delay, F body) {
+    auto request = keep();
+
+    // Kept in the arena, so the timer task captures only two pointers.
+    auto continuation = request->arena->create<F>(std::move(body));
+
+    get_timers().schedule(delay.count(), [request, continuation]() {
+        TRACE_DEBUG("{s}(): Continuing", request->name);
+
+        current_op = request->op;
+        current_request = request;
+        (*continuation)();
+        auto kept = current_request == nullptr;
+        current_request = nullptr;
+        current_op = Stats::MAX_OPS;
+
+        if (!kept) {
+            finish(request);
+        }
+    });
+}
+
+// The events of a session, delivered through a single callback and context.
+// The thread pushing an event delivers it, along with the events pushed by
+// other threads meanwhile, so the events keep their order and the ones that
+// pile up during a call go out together in the next one.
+template<typename E>
+class EventStream {
+public:
+    typedef void (*Callback)(void*, const FfiResult*, const E*, size_t);
+
+    EventStream(void* ctx, Callback o_cb) : ctx(ctx), o_cb(o_cb) {}
+
+    // Pass the request (see `keep`) with the last event of the session: it's
+    // finished once that event is delivered, which frees the stream.
+    void push(const E& event, RequestState* last = nullptr) {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        pending.push_back(event);
+        if (last) {
+            this->last = last;
+        }
+
+        if (delivering) {
+            return;
+        }
+
+        delivering = true;
+
+        std::vector<E> batch;
+        while (!pending.empty()) {
+            batch.swap(pending);
+            lock.unlock();
+
+            auto result = ok();
+            o_cb(ctx, &result, batch.data(), batch.size());
+            batch.clear();
+
+            lock.lock();
+        }
+
+        delivering = false;
+        auto request = this->last;
+        lock.unlock();
+
+        if (request) {
+            finish(request);
+        }
+    }
+
+private:
+    void* ctx;
+    Callback o_cb;
+
+    std::mutex mutex;
+    std::vector<E> pending;
+    bool delivering = false;
+    RequestState* last = nullptr;
+};
+
 void register_app(const AppInfo* app_info, void* ctx, cb_void_t o_cb)
 {
-    run("register_app", [=]() {
+    run("register_app", fail_with(o_cb, ctx), [=]() {
         auto result = ok();
         o_cb(ctx, &result);
     });
@@ -58,7 +389,7 @@ void get_app_id(const AppInfo* app_info, void* ctx, cb_i32_t o_cb)
 {
     auto id = app_info->id;
 
-    run("get_app_id", [=]() {
+    run("get_app_id", fail_with(o_cb, ctx), [=]() {
         auto result = ok();
         o_cb(ctx, &result, id);
     });
@@ -66,11 +397,12 @@ void get_app_id(const AppInfo* app_info, void* ctx, cb_i32_t o_cb)
 
 void get_app_name(const AppInfo* app_info, void* ctx, cb_string_t o_cb)
 {
-    std::string name(app_info->name);
+    auto arena = arenas.acquire();
+    auto name = arena->copy(app_info->name);
 
-    run("get_app_name", [=]() {
+    run("get_app_name", arena, fail_with(o_cb, ctx), [=]() {
         auto result = ok();
-        o_cb(ctx, &result, name.c_str());
+        o_cb(ctx, &result, name);
     });
 }
 
@@ -78,7 +410,7 @@ void get_app_key(const AppInfo* app_info, void* ctx, cb_Key_t o_cb)
 {
     auto key = app_info->key;
 
-    run("get_app_key", [=]() {
+    run("get_app_key", fail_with(o_cb, ctx), [=]() {
         auto result = ok();
         o_cb(ctx, &result, &key);
     });
@@ -86,44 +418,128 @@ void get_app_key(const AppInfo* app_info, void* ctx, cb_Key_t o_cb)
 
 void random_numbers(void* ctx, cb_i32_array_t o_cb)
 {
-    run("random_numbers", [=]() {
+    run("random_numbers", fail_with(o_cb, ctx), [=]() {
+        static const int32_t numbers[] = { 1, 1, 2, 3, 5, 8, 13, 21 };
+
         auto result = ok();
-        std::vector<int32_t> numbers = { 1, 1, 2, 3, 5, 8, 13, 21 };
-        o_cb(ctx, &result, &numbers[0], numbers.size());
+        o_cb(ctx, &result, numbers, sizeof(numbers) / sizeof(numbers[0]));
     });
 }
 
 void random_keys(void* ctx, cb_Key_array_t o_cb)
 {
-    run("random_keys", [=]() {
+    run("random_keys", fail_with(o_cb, ctx), [=]() {
         auto result = ok();
 
-        size_t count = 5;
+        const size_t count = 5;
+        Key keys[count];
 
-        std::vector<Key> keys;
-        keys.reserve(count);
-
-        for (auto i = 0; i < count; ++i) {
+        for (size_t i = 0; i < count; ++i) {
             auto byte = (int8_t) i;
-            keys.push_back(Key {{ byte, byte, byte, byte, byte, byte, byte, byte }});
+            keys[i] = Key {{ byte, byte, byte, byte, byte, byte, byte, byte }};
         }
 
-        o_cb(ctx, &result, &keys[0], keys.size());
+        o_cb(ctx, &result, keys, count);
     });
 }
 
+// Outputs are generated in streams of this many bytes, each seeded from its
+// index, so the values don't depend on how the streams are spread over the
+// pool. Outputs of at least `PARALLEL_RANDOM_MIN` bytes are.
+const size_t RANDOM_CHUNK = 256 << 10;
+const size_t PARALLEL_RANDOM_MIN = 1 << 20;
+
+void random_fill(uint64_t seed, uint8_t* out, size_t len) {
+    auto count = (len + RANDOM_CHUNK - 1) / RANDOM_CHUNK;
+
+    auto chunk = [=](size_t i) {
+        auto begin = i * RANDOM_CHUNK;
+
+        Xoshiro rng(seed, i);
+        rng.fill(out + begin, std::min(RANDOM_CHUNK, len - begin));
+    };
+
+    if (len < PARALLEL_RANDOM_MIN) {
+        for (size_t i = 0; i < count; ++i) {
+            chunk(i);
+        }
+    } else {
+        get_executor().for_each(count, chunk);
+    }
+}
+
+void random_numbers_fill(uint64_t seed, int32_t* out, size_t count)
+{
+    TRACE_DEBUG("random_numbers_fill(): {} numbers", count);
+    random_fill(seed, (uint8_t*) out, count * sizeof(int32_t));
+}
+
+void random_keys_fill(uint64_t seed, Key* out, size_t count)
+{
+    TRACE_DEBUG("random_keys_fill(): {} keys", count);
+    random_fill(seed, (uint8_t*) out, count * sizeof(Key));
+}
+
 void get_app_info(const AppInfo* app_info, void* ctx, cb_i32_string_Key_t o_cb)
 {
     auto id = app_info->id;
-    std::string name(app_info->name);
     auto key = app_info->key;
 
-    run("get_app_info", [=]() {
+    auto arena = arenas.acquire();
+    auto name = arena->copy(app_info->name);
+
+    run("get_app_info", arena, fail_with(o_cb, ctx), [=]() {
+        auto result = ok();
+        o_cb(ctx, &result, id, name, &key);
+    });
+}
+
+// Like `register_app`, registration doesn't look at the app and can't fail, so
+// every code is 0 and the apps themselves aren't needed.
+void register_apps(const AppInfo* /*ptr*/, size_t len, void* ctx, cb_i32_array_t o_cb)
+{
+    auto arena = arenas.acquire();
+
+    auto codes = (int32_t*) arena->allocate(len * sizeof(int32_t), alignof(int32_t));
+    std::fill(codes, codes + len, 0);
+
+    run("register_apps", arena, fail_with(o_cb, ctx), [=]() {
         auto result = ok();
-        o_cb(ctx, &result, id, name.c_str(), &key);
+        o_cb(ctx, &result, codes, len);
     });
 }
 
+void get_app_infos(const AppInfo* ptr, size_t len, void* ctx, cb_i32_array_AppInfo_array_t o_cb)
+{
+    auto arena = arenas.acquire();
+
+    auto codes = (int32_t*) arena->allocate(len * sizeof(int32_t), alignof(int32_t));
+    std::fill(codes, codes + len, 0);
+
+    auto infos = arena->copy(ptr, len);
+    for (size_t i = 0; i < len; ++i) {
+        infos[i].name = arena->copy(ptr[i].name);
+    }
+
+    run("get_app_infos", arena, fail_with(o_cb, ctx), [=]() {
+        auto result = ok();
+        o_cb(ctx, &result, codes, infos, len);
+    });
+}
+
+// Returns "<locator>:<password>", allocated in the arena.
+char* join(Arena* arena, const char* locator, const char* password) {
+    auto locator_len = strlen(locator);
+    auto password_len = strlen(password);
+
+    auto output = (char*) arena->allocate(locator_len + 1 + password_len + 1, 1);
+    memcpy(output, locator, locator_len);
+    output[locator_len] = ':';
+    memcpy(output + locator_len + 1, password, password_len + 1);
+
+    return output;
+}
+
 void create_account(const char*  locator,
                     const char*  password,
                     void*        ctx,
@@ -132,107 +548,338 @@ void create_account(const char*  locator,
 {
     using namespace std::chrono_literals;
 
-    std::string name(locator);
-    name.append(":");
-    name.append(password);
+    auto arena = arenas.acquire();
+    auto name = join(arena, locator, password);
 
-    run("create_account", [=]() {
+    auto reject = [=](const FfiResult* result) {
+        fail_with(o_connect_cb, ctx)(result);
+        fail_with(o_disconnect_cb, ctx)(result);
+    };
+
+    run("create_account", arena, reject, [=]() {
         auto result = ok();
         auto app_info = AppInfo {
             .id = 5678,
-            .name = const_cast<char*>(name.c_str()),
+            .name = name,
             .key = Key {{ 0, 4, 6, 8, 9, 10, 12, 14 }}
         };
 
-        cout << "- C: create_account(): calling connect callback..." << endl;
+        TRACE_INFO("create_account(): calling connect callback...");
         o_connect_cb(ctx, &result, &app_info);
 
-        std::this_thread::sleep_for(2s);
+        // The session is a timer entry while it's open, not a sleeping thread.
+        continue_after(2s, [=]() {
+            TRACE_INFO("create_account(): calling disconnect callback...");
 
-        cout << "- C: create_account(): calling disconnect callback..." << endl;
-        o_disconnect_cb(ctx, &result);
+            auto result = ok();
+            o_disconnect_cb(ctx, &result);
+        });
     });
 }
 
-/*
-void create_account_2(const char*             locator,
-                      const char*             password,
-                      void*                   ctx,
-                      cb_CreateAccountEvent_t o_cb)
+void create_account_2(const char*                   locator,
+                      const char*                   password,
+                      void*                         ctx,
+                      cb_CreateAccountEvent_array_t o_cb)
 {
     using namespace std::chrono_literals;
 
-    std::string name(locator);
-    name.append(":");
-    name.append(password);
+    auto arena = arenas.acquire();
+    auto name = join(arena, locator, password);
+    auto events = arena->create<EventStream<CreateAccountEvent>>(ctx, o_cb);
 
-    run("create_account_2", [=]() {
-        {
-            cout << "- C: create_account_2(): calling connect callback..." << endl;
+    run("create_account_2", arena, fail_with(o_cb, ctx), [=]() {
+        TRACE_INFO("create_account_2(): sending connect event...");
 
-            auto result = ok();
-            AppInfo app_info = {
+        CreateAccountEvent event;
+        event.type = CREATE_ACCOUNT_CONNECT;
+        event.connected = CreateAccountConnect {
+            .app_info = AppInfo {
                 .id = 91011,
-                .name = const_cast<char*>(name.c_str()),
+                .name = name,
                 .key = Key {{ 15, 16, 18, 20, 21, 22, 24, 25 }}
-            };
-
-            CreateAccountEvent event;
-            event.type = CREATE_ACCOUNT_CONNECT;
-            event.connected = CreateAccountConnect { .app_info = app_info };
-
-            o_cb(ctx, &result, &event);
-        }
+            }
+        };
 
-        std::this_thread::sleep_for(2s);
+        events->push(event);
 
-        {
-            cout << "- C: create_account_2(): calling disconnect callback..." << endl;
+        continue_after(2s, [=]() {
+            TRACE_INFO("create_account_2(): sending disconnect event...");
 
-            auto result = ok();
             CreateAccountEvent event;
             event.type = CREATE_ACCOUNT_DISCONNECT;
             event.disconnected = CreateAccountDisconnect {};
 
-            o_cb(ctx, &result, &event);
+            events->push(event, keep());
+        });
+    });
+}
+
+// Inputs at least this large are scanned in chunks spread over the pool.
+const size_t PARALLEL_SCAN_MIN = 4 << 20;
+const size_t PARALLEL_SCAN_CHUNK = 1 << 20;
+
+bool any_nonzero(const uint8_t* ptr, size_t len) {
+    if (len < PARALLEL_SCAN_MIN) {
+        return scan_any_nonzero(ptr, len);
+    }
+
+    auto& pool = get_executor();
+    auto chunk = std::max(PARALLEL_SCAN_CHUNK, len / (pool.size() * 4));
+    auto count = (len + chunk - 1) / chunk;
+
+    // Chunks starting after a hit was found are skipped.
+    std::atomic<bool> found { false };
+
+    pool.for_each(count, [&](size_t i) {
+        if (found.load(std::memory_order_relaxed)) {
+            return;
+        }
+
+        auto begin = i * chunk;
+        if (scan_any_nonzero(ptr + begin, std::min(chunk, len - begin))) {
+            found.store(true, std::memory_order_relaxed);
         }
     });
+
+    return found.load();
+}
+
+FfiResult invalid_signature() {
+    return FfiResult {
+        .error_code = -11,
+        .error = (char*) "Invalid signature",
+    };
+}
+
+FfiResult check_signature(const uint8_t* ptr, size_t len) {
+    if (any_nonzero(ptr, len)) {
+        return ok();
+    } else {
+        return invalid_signature();
+    }
 }
-*/
 
 void verify_signature(const uint8_t* ptr, size_t len, void* ctx, cb_void_t o_cb) {
-    std::vector<uint8_t> data(ptr, ptr + len);
+    auto arena = arenas.acquire();
+    auto data = arena->copy(ptr, len);
 
-    run("verify_signature", [=]() {
-        bool valid = std::any_of(data.begin(), data.end(), [=](auto e) {
-            return e != 0;
-        });
+    run("verify_signature", arena, fail_with(o_cb, ctx), [=]() {
+        auto result = check_signature(data, len);
+        o_cb(ctx, &result);
+    });
+}
 
-        if (valid) {
-            auto result = ok();
-            o_cb(ctx, &result);
-        } else {
-            FfiResult result = {
-                .error_code = -11,
-                .error = (char*) "Invalid signature",
-            };
-            o_cb(ctx, &result);
+void verify_signature_borrowed(const uint8_t* ptr, size_t len, void* ctx, cb_void_t o_cb) {
+    run("verify_signature_borrowed", fail_with(o_cb, ctx), [=]() {
+        auto result = check_signature(ptr, len);
+        o_cb(ctx, &result);
+    });
+}
+
+struct VerifySession {
+    bool found = false;
+};
+
+VerifySession* verify_signature_begin() {
+    return new VerifySession;
+}
+
+void verify_signature_update(VerifySession* session, const uint8_t* ptr, size_t len) {
+    // The result is settled by the first hit, so the rest of the stream is
+    // skipped.
+    if (!session->found) {
+        session->found = any_nonzero(ptr, len);
+    }
+}
+
+void verify_signature_finish(VerifySession* session, void* ctx, cb_void_t o_cb) {
+    auto found = session->found;
+    delete session;
+
+    run("verify_signature_finish", fail_with(o_cb, ctx), [=]() {
+        auto result = found ? ok() : invalid_signature();
+        o_cb(ctx, &result);
+    });
+}
+
+// Keys are checked in chunks of this many (32 KiB), which stay in the L1 cache
+// while they're worked on. Inputs of at least `PARALLEL_KEYS_MIN` keys have
+// their chunks spread over the pool.
+const size_t KEYS_CHUNK = 4096;
+const size_t PARALLEL_KEYS_MIN = 64 * 1024;
+
+// Call `f(i, begin, end)` for each chunk `i` of `len` keys.
+template<typename F>
+void for_each_key_chunk(size_t len, F f) {
+    auto count = (len + KEYS_CHUNK - 1) / KEYS_CHUNK;
+
+    auto chunk = [&](size_t i) {
+        auto begin = i * KEYS_CHUNK;
+        f(i, begin, std::min(begin + KEYS_CHUNK, len));
+    };
+
+    if (len < PARALLEL_KEYS_MIN) {
+        for (size_t i = 0; i < count; ++i) {
+            chunk(i);
+        }
+    } else {
+        get_executor().for_each(count, chunk);
+    }
+}
+
+// A key is invalid if all its bytes are zero. It's checked as one word, so the
+// loops below have no data-dependent branches.
+inline bool is_invalid(const Key& key) {
+    uint64_t word;
+    memcpy(&word, key.bytes, sizeof(word));
+    return word == 0;
+}
+
+size_t count_invalid_keys(const Key* keys, size_t begin, size_t end) {
+    size_t count = 0;
+
+    for (size_t i = begin; i < end; ++i) {
+        count += is_invalid(keys[i]);
+    }
+
+    return count;
+}
+
+FfiResult invalid_key() {
+    return FfiResult {
+        .error_code = -12,
+        .error = (char*) "Invalid key",
+    };
+}
+
+FfiResult check_keys(const Key* keys, size_t len) {
+    std::atomic<size_t> invalid { 0 };
+
+    for_each_key_chunk(len, [&](size_t, size_t begin, size_t end) {
+        if (auto count = count_invalid_keys(keys, begin, end)) {
+            invalid.fetch_add(count, std::memory_order_relaxed);
         }
     });
+
+    TRACE_DEBUG("verify_keys(): {} of {} keys invalid", invalid.load(), len);
+
+    return invalid.load() == 0 ? ok() : invalid_key();
 }
 
-void verify_keys(const Key* ptr, size_t len, void* ctx, cb_void_t o_cb) {
-    std::vector<Key> keys(ptr, ptr + len);
+// Find the indices of the invalid keys, in ascending order, allocating them in
+// the arena. Each chunk is counted first, so the indices can then be written
+// in parallel, every chunk at its own offset.
+void find_invalid_keys(Arena* arena, const Key* keys, size_t len, int32_t*& out, size_t& out_len) {
+    auto count = (len + KEYS_CHUNK - 1) / KEYS_CHUNK;
+    auto offsets = (size_t*) arena->allocate((count + 1) * sizeof(size_t), alignof(size_t));
 
-    run("verify_keys", [=]() {
-        for (auto& key : keys) {
-            cout << "- C: verify_keys(): ";
-            print_key(cout, key);
-            cout << endl;
+    offsets[0] = 0;
+    for_each_key_chunk(len, [&](size_t i, size_t begin, size_t end) {
+        offsets[i + 1] = count_invalid_keys(keys, begin, end);
+    });
+
+    for (size_t i = 0; i < count; ++i) {
+        offsets[i + 1] += offsets[i];
+    }
+
+    out_len = offsets[count];
+    out = (int32_t*) arena->allocate(out_len * sizeof(int32_t), alignof(int32_t));
+
+    // Every key index is stored, and kept by advancing past it only if the key
+    // is invalid. The loop ends once the chunk's last invalid key is found, so
+    // the stores never reach the next chunk's slots.
+    for_each_key_chunk(len, [&](size_t i, size_t begin, size_t) {
+        auto next = out + offsets[i];
+        auto last = out + offsets[i + 1];
+
+        for (size_t j = begin; next < last; ++j) {
+            *next = (int32_t) j;
+            next += is_invalid(keys[j]);
         }
+    });
+}
+
+void verify_keys(const Key* ptr, size_t len, void* ctx, cb_void_t o_cb) {
+    auto arena = arenas.acquire();
+    auto keys = arena->copy(ptr, len);
+
+    run("verify_keys", arena, fail_with(o_cb, ctx), [=]() {
+        auto result = check_keys(keys, len);
+        o_cb(ctx, &result);
+    });
+}
+
+void find_invalid_keys(const Key* ptr, size_t len, void* ctx, cb_i32_array_t o_cb) {
+    auto arena = arenas.acquire();
+    auto keys = arena->copy(ptr, len);
+
+    run("find_invalid_keys", arena, fail_with(o_cb, ctx), [=]() {
+        int32_t* invalid;
+        size_t invalid_len;
+        find_invalid_keys(arena, keys, len, invalid, invalid_len);
 
         auto result = ok();
+        o_cb(ctx, &result, invalid, invalid_len);
+    });
+}
+
+// "<path>: <message>", allocated in the arena.
+FfiResult file_error(Arena* arena, const char* path, const std::string& message) {
+    auto path_len = strlen(path);
+
+    auto error = (char*) arena->allocate(path_len + 2 + message.size() + 1, 1);
+    memcpy(error, path, path_len);
+    memcpy(error + path_len, ": ", 2);
+    memcpy(error + path_len + 2, message.c_str(), message.size() + 1);
+
+    return FfiResult {
+        .error_code = BACKEND_ERROR_FILE,
+        .error = error
+    };
+}
+
+// Maps the file at `path` on the worker, then calls `check` with the mapping,
+// or reports why it can't be mapped. The file stays mapped until the callback
+// returns. `check` also gets the request arena and its copy of the path, to
+// report errors.
+template<typename F>
+void run_on_file(const char* name, const char* path, void* ctx, cb_void_t o_cb, F check) {
+    auto arena = arenas.acquire();
+    path = arena->copy(path);
+
+    run(name, arena, fail_with(o_cb, ctx), [=]() {
+        MappedFile file;
+
+        if (auto error = file.open(path)) {
+            auto result = file_error(arena, path, std::generic_category().message(error));
+            o_cb(ctx, &result);
+            return;
+        }
+
+        auto result = check(arena, path, file.data(), file.size());
         o_cb(ctx, &result);
     });
 }
 
+void verify_signature_file(const char* path, void* ctx, cb_void_t o_cb) {
+    auto check = [](Arena*, const char*, const uint8_t* ptr, size_t len) {
+        return check_signature(ptr, len);
+    };
+
+    run_on_file("verify_signature_file", path, ctx, o_cb, check);
+}
+
+void verify_keys_file(const char* path, void* ctx, cb_void_t o_cb) {
+    auto check = [](Arena* arena, const char* path, const uint8_t* ptr, size_t len) {
+        if (len % sizeof(Key) != 0) {
+            return file_error(arena, path, "Size is not a multiple of the key size");
+        }
+
+        // The mapping is page aligned, so the keys are too.
+        return check_keys((const Key*) ptr, len / sizeof(Key));
+    };
+
+    run_on_file("verify_keys_file", path, ctx, o_cb, check);
+}
+
@@ -31,6 +31,116 @@ extern "C" {
     typedef void(*cb_Key_array_t)(void*, const FfiResult*, const Key*, size_t);
     typedef void(*cb_i32_string_Key_t)(void*, const FfiResult*, int32_t, const char*, const Key*);
     typedef void(*cb_AppInfo_t)(void*, const FfiResult*, const AppInfo*);
+    typedef void(*cb_i32_array_AppInfo_array_t)(void*, const FfiResult*, const int32_t*, const AppInfo*, size_t);
+
+    // Start the worker pool the calls below run on, using `num_threads` workers
+    // (0 means one per hardware thread). Optional - the first call into the
+    // backend starts the pool with the default size. Has no effect if the pool
+    // is already running.
+    void backend_init(size_t num_threads);
+    // Wait for all pending calls to finish and stop the worker pool. Must not
+    // be called from inside a callback.
+    void backend_shutdown(void);
+    // Write the backend trace to the file at `path` (appending) instead of the
+    // standard output. The `BACKEND_TRACE_FILE` environment variable does the
+    // same at startup. Returns false if the file can't be opened.
+    bool backend_trace_open(const char* path);
+
+    // Completion queue: an alternative to receiving results through callbacks.
+    // The results are pushed into the queue by the backend threads and then
+    // drained in batches by a single consumer thread.
+    #define COMPLETION_PAYLOAD_SIZE 48
+
+    typedef struct Completion {
+        uint64_t request_id;
+        int32_t error_code;
+        uint32_t payload_len;
+        uint8_t payload[COMPLETION_PAYLOAD_SIZE];
+    } Completion;
+
+    typedef struct CompletionQueue CompletionQueue;
+
+    // Create a queue able to hold at least `capacity` completions.
+    CompletionQueue* completion_queue_new(size_t capacity);
+    void completion_queue_free(CompletionQueue* queue);
+    // Push a completion. Payloads longer than `COMPLETION_PAYLOAD_SIZE` are
+    // truncated. Never blocks: when the queue is full, the completion is kept
+    // aside and handed out by a later poll.
+    void completion_queue_push(CompletionQueue* queue,
+                               uint64_t request_id,
+                               const FfiResult* result,
+                               const void* payload,
+                               size_t payload_len);
+    // Copy up to `max` completions into `out`, returning how many were copied.
+    // Must not be called from more than one thread at a time.
+    size_t completion_queue_poll(CompletionQueue* queue, Completion* out, size_t max);
+
+    // Statistics: per-operation call counts and latency histograms.
+    #define STATS_BUCKETS 32
+
+    typedef enum StatsPhase {
+        // From the call to the start of its execution on a worker.
+        STATS_QUEUE = 0,
+        // Execution on the worker, including the callback.
+        STATS_EXECUTE = 1,
+        // Conversion of the callback arguments by the bindings.
+        STATS_MARSHAL = 2,
+        // The call into the frontend language by the bindings.
+        STATS_UPCALL = 3,
+        STATS_PHASES = 4
+    } StatsPhase;
+
+    typedef struct OpStats {
+        const char* name;
+        uint64_t count;
+        uint64_t total_ns[STATS_PHASES];
+        // Bucket `i` counts the durations in the [2^i, 2^(i+1)) ns range.
+        uint64_t histogram[STATS_PHASES][STATS_BUCKETS];
+    } OpStats;
+
+    // Copy the statistics of up to `max` operations into `out`, returning how
+    // many were copied.
+    size_t backend_get_stats(OpStats* out, size_t max);
+    // Record a phase of the callback currently running on this thread. Used by
+    // the bindings to report the `STATS_MARSHAL` and `STATS_UPCALL` phases.
+    void backend_record_callback_stat(StatsPhase phase, uint64_t ns);
+    // Monotonic clock used by the statistics, in nanoseconds.
+    uint64_t backend_now_ns(void);
+
+    // Admission control: limits on the calls in flight (from the call until its
+    // callback returns) and on the size of the inputs they buffer. What happens
+    // to a call over the limit depends on the policy of the calling thread.
+    #define BACKEND_ERROR_OVERLOADED -20
+
+    typedef enum AdmissionPolicy {
+        // Block the caller until the call fits. Calls made from inside a
+        // callback are queued instead, since blocking there could deadlock.
+        ADMISSION_BLOCK = 0,
+        // Call the callback(s) right away, before the function returns, with
+        // the `BACKEND_ERROR_OVERLOADED` error.
+        ADMISSION_FAIL_FAST = 1,
+        // Accept the call and start it once it fits, in FIFO order.
+        ADMISSION_QUEUE = 2
+    } AdmissionPolicy;
+
+    typedef struct AdmissionStats {
+        uint64_t max_requests;
+        uint64_t max_bytes;
+        // Current occupancy.
+        uint64_t requests;
+        uint64_t bytes;
+        // Calls accepted but waiting to start.
+        uint64_t queued;
+        // Total calls failed with `BACKEND_ERROR_OVERLOADED`.
+        uint64_t rejected;
+    } AdmissionStats;
+
+    // Set the limits. 0 means no limit, which is the default.
+    void backend_set_limits(size_t max_requests, size_t max_bytes);
+    // Set the policy of the calls made by the current thread. Defaults to
+    // `ADMISSION_BLOCK`.
+    void backend_set_admission_policy(AdmissionPolicy policy);
+    void backend_get_admission(AdmissionStats* out);
 
     // One callback with 0 params
     void register_app(const AppInfo* app_info, void* ctx, cb_void_t o_cb);
@@ -44,6 +154,13 @@ extern "C" {
     void random_numbers(void* ctx, cb_i32_array_t o_cb);
     // One callback with array of native structs param
     void random_keys(void* ctx, cb_Key_array_t o_cb);
+    // Bulk variants of `random_numbers` and `random_keys`, for load tests and
+    // key provisioning: fill `out` with `count` pseudo-random numbers or keys,
+    // in place, before returning. Large outputs are generated in parallel. A
+    // given seed always gives the same sequence, whatever the count and the
+    // number of threads. Not suitable for cryptographic use.
+    void random_numbers_fill(uint64_t seed, int32_t* out, size_t count);
+    void random_keys_fill(uint64_t seed, Key* out, size_t count);
     // One callback with multiple arguments
     void get_app_info(const AppInfo* app_info, void* ctx, cb_i32_string_Key_t o_cb);
     // Multiple callbacks
@@ -53,12 +170,49 @@ extern "C" {
                         cb_AppInfo_t o_connect_cb,
                         cb_void_t    o_disconnect_cb);
 
+    // Batch variants, for many apps at once. The callback gets one error code
+    // per app (0 on success), in the input order.
+    void register_apps(const AppInfo* ptr, size_t len, void* ctx, cb_i32_array_t o_cb);
+    // The callback gets the codes and the info of each app, in the same order.
+    void get_app_infos(const AppInfo* ptr, size_t len, void* ctx, cb_i32_array_AppInfo_array_t o_cb);
+
     // Input array of primitive type
     void verify_signature(const uint8_t* ptr, size_t len, void* ctx, cb_void_t o_cb);
-    // Input array of native structs
+    // Same as `verify_signature`, but without copying the input. The caller must
+    // keep `ptr` valid until the callback is called.
+    void verify_signature_borrowed(const uint8_t* ptr, size_t len, void* ctx, cb_void_t o_cb);
+    // Streaming variant of `verify_signature`, for inputs that arrive in
+    // chunks. `update` scans the chunk before returning, without copying it, so
+    // the caller can reuse its buffer right away. `finish` calls the callback
+    // with the result for all the chunks and frees the session.
+    typedef struct VerifySession VerifySession;
+
+    VerifySession* verify_signature_begin(void);
+    void verify_signature_update(VerifySession* session, const uint8_t* ptr, size_t len);
+    void verify_signature_finish(VerifySession* session, void* ctx, cb_void_t o_cb);
+
+    // Input array of native structs. A key is invalid if all its bytes are
+    // zero. Large inputs are checked in parallel.
     void verify_keys(const Key* ptr, size_t len, void* ctx, cb_void_t o_cb);
+    // Like `verify_keys`, but the callback gets the indices of the invalid
+    // keys, in ascending order (none if they're all valid). The indices are
+    // 32-bit, so `len` must be below 2^31.
+    void find_invalid_keys(const Key* ptr, size_t len, void* ctx, cb_i32_array_t o_cb);
+
+    // File variants of `verify_signature` and `verify_keys`: the input is the
+    // content of the file at `path`, mapped into memory instead of read, so it
+    // can be larger than the RAM. For `verify_keys_file`, the file holds the
+    // raw keys back to back. Failing to open or map the file is reported
+    // through the callback, with the `BACKEND_ERROR_FILE` error.
+    #define BACKEND_ERROR_FILE -21
+
+    void verify_signature_file(const char* path, void* ctx, cb_void_t o_cb);
+    void verify_keys_file(const char* path, void* ctx, cb_void_t o_cb);
 
-    /*
+    // Single callback variant of `create_account`: the callback gets the
+    // events of the session, in order, until the disconnect event, which is
+    // the last one. Events that are pending together come in one call. If the
+    // call is rejected, the callback gets the error and no events instead.
     #define CREATE_ACCOUNT_CONNECT    1
     #define CREATE_ACCOUNT_DISCONNECT 2
 
@@ -78,13 +232,12 @@ extern "C" {
         };
     } CreateAccountEvent;
 
-    typedef void(*cb_CreateAccountEvent_t)(void*, const FfiResult*, const CreateAccountEvent*);
+    typedef void(*cb_CreateAccountEvent_array_t)(void*, const FfiResult*, const CreateAccountEvent*, size_t);
 
-    void create_account_2(const char* locator,
-                          const char* password,
-                          void* ctx,
-                          cb_CreateAccountEvent_t o_cb);
-    */
+    void create_account_2(const char*                   locator,
+                          const char*                   password,
+                          void*                         ctx,
+                          cb_CreateAccountEvent_array_t o_cb);
 #ifdef __cplusplus
 }
 #endif
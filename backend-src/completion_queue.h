@@ -0,0 +1,132 @@
+#ifndef _COMPLETION_QUEUE_H_
+#define _COMPLETION_QUEUE_H_
+
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include "backend.h"
+
+// Bounded lock-free ring of `Completion` records. Any number of threads may
+// push, but only one thread at a time may poll. Completions that don't fit in
+// the ring go to an overflow list instead of waiting for room: the thread
+// pushing may be the consumer itself (a call rejected synchronously), and
+// waiting workers would hold up all the other requests.
+struct CompletionQueue {
+public:
+    // `capacity` is rounded up to a power of two.
+    explicit CompletionQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+
+        mask = size - 1;
+        cells.reset(new Cell[size]);
+
+        for (size_t i = 0; i < size; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    CompletionQueue(const CompletionQueue&) = delete;
+    CompletionQueue& operator = (const CompletionQueue&) = delete;
+
+    size_t capacity() const {
+        return mask + 1;
+    }
+
+    // Returns false if the queue is full.
+    bool try_push(const Completion& completion) {
+        auto pos = enqueue_pos.load(std::memory_order_relaxed);
+        Cell* cell;
+
+        for (;;) {
+            cell = &cells[pos & mask];
+
+            auto seq = cell->sequence.load(std::memory_order_acquire);
+            auto diff = (intptr_t) seq - (intptr_t) pos;
+
+            if (diff == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->data = completion;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Never blocks. Goes to the overflow list when the ring is full.
+    void push(const Completion& completion) {
+        if (try_push(completion)) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(overflow_mutex);
+        overflow.push_back(completion);
+        overflow_size.store(overflow.size(), std::memory_order_release);
+    }
+
+    // Copy up to `max` completions into `out` and return how many were copied.
+    // The ring is drained first, then the overflow list.
+    size_t poll(Completion* out, size_t max) {
+        size_t count = 0;
+
+        while (count < max) {
+            auto& cell = cells[dequeue_pos & mask];
+
+            if (cell.sequence.load(std::memory_order_acquire) != dequeue_pos + 1) {
+                break;
+            }
+
+            out[count++] = cell.data;
+            cell.sequence.store(dequeue_pos + mask + 1, std::memory_order_release);
+            ++dequeue_pos;
+        }
+
+        if (count < max && overflow_size.load(std::memory_order_acquire) > 0) {
+            std::lock_guard<std::mutex> lock(overflow_mutex);
+
+            while (count < max && !overflow.empty()) {
+                out[count++] = overflow.front();
+                overflow.pop_front();
+            }
+
+            overflow_size.store(overflow.size(), std::memory_order_release);
+        }
+
+        return count;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        Completion data;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+
+    // Padded apart so the producers and the consumer don't share a cache line.
+    char pad0[64];
+    std::atomic<size_t> enqueue_pos { 0 };
+    char pad1[64];
+    size_t dequeue_pos = 0;
+
+    // Bounded by the calls in flight, which admission control limits.
+    std::mutex overflow_mutex;
+    std::deque<Completion> overflow;
+    std::atomic<size_t> overflow_size { 0 };
+};
+
+#endif
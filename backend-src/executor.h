@@ -0,0 +1,208 @@
+#ifndef _EXECUTOR_H_
+#define _EXECUTOR_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads. Each worker owns a task queue. Workers
+// take tasks from the front of their own queue, so requests run in the order
+// they were submitted and none is left behind newer ones under sustained load.
+// When their queue is empty, they steal from the back of the other workers'
+// queues, which is where the helpers of a `for_each` in progress are.
+class Executor {
+public:
+    explicit Executor(size_t num_threads) {
+        if (num_threads == 0) {
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        for (size_t i = 0; i < num_threads; ++i) {
+            queues.emplace_back(new Queue);
+        }
+
+        for (size_t i = 0; i < num_threads; ++i) {
+            threads.emplace_back([=]() { work(i); });
+        }
+    }
+
+    ~Executor() {
+        shutdown();
+    }
+
+    Executor(const Executor&) = delete;
+    Executor& operator = (const Executor&) = delete;
+
+    size_t size() const {
+        return queues.size();
+    }
+
+    // Schedule the task. Tasks submitted from a worker go to that worker's own
+    // queue, others are spread over the workers round-robin.
+    void submit(std::function<void()> task) {
+        auto& worker = this_worker();
+        auto index = worker.owner == this
+                   ? worker.index
+                   : next.fetch_add(1, std::memory_order_relaxed) % queues.size();
+
+        pending.fetch_add(1);
+
+        {
+            std::lock_guard<std::mutex> lock(queues[index]->mutex);
+            queues[index]->tasks.push_back(std::move(task));
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+        }
+        cond.notify_one();
+    }
+
+    // Call `f(i)` for each `i` in [0, count), spread over the workers. The
+    // calling thread takes part, and returns once all the calls are done. It
+    // never waits for a call that hasn't started, so it's safe to use from
+    // inside a task even when all the workers are busy.
+    template<typename F>
+    void for_each(size_t count, F f) {
+        struct State {
+            State(size_t count, F f) : count(count), f(std::move(f)) {}
+
+            const size_t count;
+            F f;
+            std::atomic<size_t> next { 0 };
+            std::atomic<size_t> done { 0 };
+            std::mutex mutex;
+            std::condition_variable cond;
+        };
+
+        // Shared with the helper tasks, which may start after this returns.
+        auto state = std::make_shared<State>(count, std::move(f));
+
+        auto work = [state]() {
+            for (;;) {
+                auto i = state->next.fetch_add(1);
+                if (i >= state->count) {
+                    return;
+                }
+
+                state->f(i);
+
+                if (state->done.fetch_add(1) + 1 == state->count) {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    state->cond.notify_all();
+                }
+            }
+        };
+
+        auto helpers = std::min(count, queues.size()) - (count > 0 ? 1 : 0);
+        for (size_t i = 0; i < helpers; ++i) {
+            submit(work);
+        }
+
+        work();
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->cond.wait(lock, [&]() { return state->done.load() == count; });
+    }
+
+    // Finish all the pending tasks and join the workers. Must not be called
+    // from inside a task.
+    void shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) {
+                return;
+            }
+            stopping = true;
+        }
+        cond.notify_all();
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    struct WorkerId {
+        const Executor* owner;
+        size_t index;
+    };
+
+    // Identifies the pool worker running on the current thread, if any.
+    static WorkerId& this_worker() {
+        thread_local WorkerId id { nullptr, 0 };
+        return id;
+    }
+
+    bool pop(size_t index, std::function<void()>& task) {
+        auto& queue = *queues[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        if (queue.tasks.empty()) {
+            return false;
+        }
+
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return true;
+    }
+
+    bool steal(size_t index, std::function<void()>& task) {
+        for (size_t i = 1; i < queues.size(); ++i) {
+            auto& queue = *queues[(index + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+
+            if (!queue.tasks.empty()) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void work(size_t index) {
+        this_worker() = WorkerId { this, index };
+
+        for (;;) {
+            std::function<void()> task;
+
+            if (pop(index, task) || steal(index, task)) {
+                pending.fetch_sub(1);
+                task();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [&]() { return stopping || pending.load() > 0; });
+
+            if (stopping && pending.load() == 0) {
+                return;
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool stopping = false;
+
+    std::atomic<size_t> pending { 0 };
+    std::atomic<size_t> next { 0 };
+};
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef _MAPPED_FILE_H_
+#define _MAPPED_FILE_H_
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only mapping of a whole file, for verifying inputs without reading them
+// into memory first. The pages are faulted in by the scan itself, with the
+// kernel reading ahead since the access is hinted as sequential.
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator = (const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (ptr) {
+            munmap(ptr, len);
+        }
+    }
+
+    // Returns 0 on success, the `errno` value otherwise.
+    int open(const char* path) {
+        auto fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return errno;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            auto error = errno;
+            close(fd);
+            return error;
+        }
+
+        len = (size_t) st.st_size;
+
+        // `mmap` rejects empty mappings, but an empty file is a valid input.
+        if (len > 0) {
+            auto mapped = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                auto error = errno;
+                close(fd);
+                len = 0;
+                return error;
+            }
+
+            ptr = mapped;
+            madvise(ptr, len, MADV_SEQUENTIAL);
+            madvise(ptr, len, MADV_WILLNEED);
+        }
+
+        // The mapping keeps the file referenced.
+        close(fd);
+        return 0;
+    }
+
+    const uint8_t* data() const {
+        return (const uint8_t*) ptr;
+    }
+
+    size_t size() const {
+        return len;
+    }
+
+private:
+    void* ptr = nullptr;
+    size_t len = 0;
+};
+
+#endif
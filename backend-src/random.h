@@ -0,0 +1,127 @@
+#ifndef _RANDOM_H_
+#define _RANDOM_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RANDOM_X86 1
+#endif
+
+// xoshiro256++ pseudo-random generator (Blackman and Vigna), running `LANES`
+// independent generators side by side. The state is laid out lane-minor, so
+// the compiler keeps the lanes in vector registers and steps them together.
+// The fill loop is also compiled for AVX2 and AVX-512, picked at runtime like
+// the scan kernels. Not suitable for cryptographic use.
+class Xoshiro {
+public:
+    static const size_t LANES = 4;
+
+    // Each (seed, stream) pair starts a distinct sequence, so a large output
+    // can be split into streams generated independently, with the same result
+    // as long as the split is the same.
+    Xoshiro(uint64_t seed, uint64_t stream) {
+        // Seeded with splitmix64, as the authors recommend. Each stream takes
+        // its own `4 * LANES` consecutive splitmix64 outputs.
+        uint64_t x = seed + stream * 4 * LANES * GAMMA;
+
+        for (size_t w = 0; w < 4; ++w) {
+            for (size_t l = 0; l < LANES; ++l) {
+                s[w][l] = splitmix64(x);
+            }
+        }
+    }
+
+    // Fill `len` bytes, one little-endian word per lane and step.
+    void fill(uint8_t* out, size_t len) {
+#ifdef RANDOM_X86
+        static const int width = []() {
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx512f") ? 512 : __builtin_cpu_supports("avx2") ? 256 : 0;
+        }();
+
+        if (width == 512) {
+            fill_avx512(out, len);
+            return;
+        }
+
+        if (width == 256) {
+            fill_avx2(out, len);
+            return;
+        }
+#endif
+
+        fill_generic(out, len);
+    }
+
+private:
+    static const uint64_t GAMMA = 0x9e3779b97f4a7c15;
+
+#ifdef RANDOM_X86
+    __attribute__((target("avx512f")))
+    void fill_avx512(uint8_t* out, size_t len) {
+        fill_generic(out, len);
+    }
+
+    __attribute__((target("avx2")))
+    void fill_avx2(uint8_t* out, size_t len) {
+        fill_generic(out, len);
+    }
+#endif
+
+    // Inlined into the target-specific variants, so it gets compiled for them.
+    __attribute__((always_inline))
+    void fill_generic(uint8_t* out, size_t len) {
+        // A local copy, which the compiler can keep in registers across steps.
+        uint64_t state[4][LANES];
+        memcpy(state, s, sizeof(state));
+
+        uint64_t words[LANES];
+
+        for (; len >= sizeof(words); out += sizeof(words), len -= sizeof(words)) {
+            next(state, words);
+            memcpy(out, words, sizeof(words));
+        }
+
+        if (len > 0) {
+            next(state, words);
+            memcpy(out, words, len);
+        }
+
+        memcpy(s, state, sizeof(state));
+    }
+
+    static uint64_t splitmix64(uint64_t& x) {
+        uint64_t z = (x += GAMMA);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return z ^ (z >> 31);
+    }
+
+    __attribute__((always_inline))
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    __attribute__((always_inline))
+    static void next(uint64_t (&s)[4][LANES], uint64_t* out) {
+        for (size_t l = 0; l < LANES; ++l) {
+            out[l] = rotl(s[0][l] + s[3][l], 23) + s[0][l];
+
+            auto t = s[1][l] << 17;
+
+            s[2][l] ^= s[0][l];
+            s[3][l] ^= s[1][l];
+            s[1][l] ^= s[2][l];
+            s[0][l] ^= s[3][l];
+
+            s[2][l] ^= t;
+            s[3][l] = rotl(s[3][l], 45);
+        }
+    }
+
+    uint64_t s[4][LANES];
+};
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef _SCAN_H_
+#define _SCAN_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+// Kernels answering "does the buffer contain a non-zero byte?", the core of
+// signature verification. Each one ORs a block of input together and tests it,
+// so it stops at the first block containing a hit. `scan_any_nonzero` picks
+// the widest one the CPU supports, once.
+
+typedef bool (*ScanKernel)(const uint8_t*, size_t);
+
+// Also handles the tails of the vector kernels.
+inline bool scan_scalar(const uint8_t* ptr, size_t len) {
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        uint64_t w[4];
+        memcpy(w, ptr + i, sizeof(w));
+
+        if ((w[0] | w[1] | w[2] | w[3]) != 0) {
+            return true;
+        }
+    }
+
+    for (; i < len; ++i) {
+        if (ptr[i] != 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+#ifdef SCAN_X86
+
+__attribute__((target("sse2")))
+inline bool scan_sse2(const uint8_t* ptr, size_t len) {
+    auto zero = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + 64 <= len; i += 64) {
+        auto p = (const __m128i*) (ptr + i);
+        auto acc = _mm_or_si128(_mm_or_si128(_mm_loadu_si128(p), _mm_loadu_si128(p + 1)),
+                                _mm_or_si128(_mm_loadu_si128(p + 2), _mm_loadu_si128(p + 3)));
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, zero)) != 0xffff) {
+            return true;
+        }
+    }
+
+    return scan_scalar(ptr + i, len - i);
+}
+
+__attribute__((target("avx2")))
+inline bool scan_avx2(const uint8_t* ptr, size_t len) {
+    size_t i = 0;
+
+    for (; i + 128 <= len; i += 128) {
+        auto p = (const __m256i*) (ptr + i);
+        auto acc = _mm256_or_si256(
+            _mm256_or_si256(_mm256_loadu_si256(p), _mm256_loadu_si256(p + 1)),
+            _mm256_or_si256(_mm256_loadu_si256(p + 2), _mm256_loadu_si256(p + 3)));
+
+        if (!_mm256_testz_si256(acc, acc)) {
+            return true;
+        }
+    }
+
+    return scan_scalar(ptr + i, len - i);
+}
+
+__attribute__((target("avx512f")))
+inline bool scan_avx512(const uint8_t* ptr, size_t len) {
+    size_t i = 0;
+
+    for (; i + 256 <= len; i += 256) {
+        auto p = ptr + i;
+        auto acc = _mm512_or_si512(
+            _mm512_or_si512(_mm512_loadu_si512(p), _mm512_loadu_si512(p + 64)),
+            _mm512_or_si512(_mm512_loadu_si512(p + 128), _mm512_loadu_si512(p + 192)));
+
+        if (_mm512_test_epi64_mask(acc, acc) != 0) {
+            return true;
+        }
+    }
+
+    return scan_scalar(ptr + i, len - i);
+}
+
+#endif
+
+struct ScanKernelInfo {
+    const char* name;
+    ScanKernel kernel;
+};
+
+// The kernels the CPU supports, widest first. Returns their number.
+inline size_t scan_kernels(ScanKernelInfo* out) {
+    size_t count = 0;
+
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f")) {
+        out[count++] = ScanKernelInfo { "avx512", scan_avx512 };
+    }
+
+    if (__builtin_cpu_supports("avx2")) {
+        out[count++] = ScanKernelInfo { "avx2", scan_avx2 };
+    }
+
+    if (__builtin_cpu_supports("sse2")) {
+        out[count++] = ScanKernelInfo { "sse2", scan_sse2 };
+    }
+#endif
+
+    out[count++] = ScanKernelInfo { "scalar", scan_scalar };
+    return count;
+}
+
+inline const ScanKernelInfo& scan_best_kernel() {
+    static const ScanKernelInfo best = []() {
+        ScanKernelInfo kernels[4];
+        scan_kernels(kernels);
+        return kernels[0];
+    }();
+
+    return best;
+}
+
+inline bool scan_any_nonzero(const uint8_t* ptr, size_t len) {
+    return scan_best_kernel().kernel(ptr, len);
+}
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include "backend.h"
+
+// Per-operation counters and latency histograms. Each thread records into its
+// own block of buckets (single writer, relaxed atomics), so recording never
+// contends. Reading sums the blocks of all the threads.
+class Stats {
+public:
+    static const size_t MAX_OPS = 32;
+
+    static uint64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Returns the index of the operation with the given name, registering it on
+    // first use. Returns MAX_OPS if the table is full.
+    size_t op(const char* name) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (size_t i = 0; i < names.size(); ++i) {
+            if (strcmp(names[i], name) == 0) {
+                return i;
+            }
+        }
+
+        if (names.size() == MAX_OPS) {
+            return MAX_OPS;
+        }
+
+        names.push_back(name);
+        return names.size() - 1;
+    }
+
+    void count(size_t op) {
+        if (op < MAX_OPS) {
+            add(local().ops[op].count, 1);
+        }
+    }
+
+    void record(size_t op, StatsPhase phase, uint64_t ns) {
+        if (op >= MAX_OPS) {
+            return;
+        }
+
+        auto& buckets = local().ops[op];
+        add(buckets.total_ns[phase], ns);
+        add(buckets.histogram[phase][bucket(ns)], 1);
+    }
+
+    size_t collect(OpStats* out, size_t max) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto count = std::min(max, names.size());
+
+        for (size_t i = 0; i < count; ++i) {
+            memset(&out[i], 0, sizeof(OpStats));
+            out[i].name = names[i];
+
+            for (auto thread : threads) {
+                auto& buckets = thread->ops[i];
+
+                out[i].count += buckets.count.load(std::memory_order_relaxed);
+
+                for (size_t p = 0; p < STATS_PHASES; ++p) {
+                    out[i].total_ns[p] += buckets.total_ns[p].load(std::memory_order_relaxed);
+
+                    for (size_t b = 0; b < STATS_BUCKETS; ++b) {
+                        out[i].histogram[p][b] +=
+                            buckets.histogram[p][b].load(std::memory_order_relaxed);
+                    }
+                }
+            }
+        }
+
+        return count;
+    }
+
+private:
+    // Only the owning thread writes, so a plain load + store is enough.
+    static void add(std::atomic<uint64_t>& counter, uint64_t value) {
+        counter.store(counter.load(std::memory_order_relaxed) + value,
+                      std::memory_order_relaxed);
+    }
+
+    struct OpBuckets {
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> total_ns[STATS_PHASES];
+        std::atomic<uint64_t> histogram[STATS_PHASES][STATS_BUCKETS];
+    };
+
+    struct ThreadBuckets {
+        OpBuckets ops[MAX_OPS];
+    };
+
+    // Buckets of the current thread. Blocks are kept after their thread exits
+    // so the totals don't go backwards. There is only one `Stats` instance, so
+    // the function-local `thread_local` is fine.
+    ThreadBuckets& local() {
+        thread_local ThreadBuckets* buckets = nullptr;
+
+        if (!buckets) {
+            buckets = new ThreadBuckets();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            threads.push_back(buckets);
+        }
+
+        return *buckets;
+    }
+
+    // Index of the histogram bucket for the duration: floor(log2(ns)).
+    static size_t bucket(uint64_t ns) {
+        size_t index = 0;
+        while (ns > 1 && index < STATS_BUCKETS - 1) {
+            ns >>= 1;
+            ++index;
+        }
+        return index;
+    }
+
+    std::mutex mutex;
+    std::vector<const char*> names;
+    std::vector<ThreadBuckets*> threads;
+};
+
+#endif
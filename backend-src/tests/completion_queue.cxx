@@ -0,0 +1,49 @@
+// Regression tests of `CompletionQueue`. Exits with a non-zero status on failure.
+
+#include <cstdio>
+#include <vector>
+
+#include "completion_queue.h"
+
+// Pushing into a full queue must not wait for room: the pushing thread may be
+// the one that polls. Nothing pushed may be lost either.
+static bool push_does_not_block_when_full() {
+    const size_t COUNT = 100;
+
+    CompletionQueue queue(8);
+
+    for (size_t i = 0; i < COUNT; ++i) {
+        Completion completion = {};
+        completion.request_id = i;
+        queue.push(completion);
+    }
+
+    std::vector<bool> seen(COUNT, false);
+    Completion out[16];
+    size_t total = 0;
+
+    while (auto count = queue.poll(out, 16)) {
+        for (size_t i = 0; i < count; ++i) {
+            seen[out[i].request_id] = true;
+        }
+        total += count;
+    }
+
+    for (size_t i = 0; i < COUNT; ++i) {
+        if (!seen[i]) {
+            printf("push_does_not_block_when_full: completion %zu lost (%zu polled)\n", i, total);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main() {
+    auto ok = true;
+
+    ok = push_does_not_block_when_full() && ok;
+
+    printf("%s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,56 @@
+// Regression tests of `Executor`. Exits with a non-zero status on failure.
+
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+#include "executor.h"
+
+// Requests submitted while the worker is busy must run in submission order,
+// so the oldest one never waits behind newer ones.
+static bool runs_submitted_tasks_in_order() {
+    const size_t COUNT = 1000;
+
+    std::mutex mutex;
+    std::vector<size_t> order;
+
+    {
+        Executor executor(1);
+
+        // Hold the worker until all the tasks are queued.
+        std::atomic<bool> release { false };
+        executor.submit([&]() {
+            while (!release.load()) {
+                std::this_thread::yield();
+            }
+        });
+
+        for (size_t i = 0; i < COUNT; ++i) {
+            executor.submit([&, i]() {
+                std::lock_guard<std::mutex> lock(mutex);
+                order.push_back(i);
+            });
+        }
+
+        release = true;
+    }
+
+    for (size_t i = 0; i < COUNT; ++i) {
+        if (order.size() != COUNT || order[i] != i) {
+            printf("runs_submitted_tasks_in_order: task %zu ran out of order\n", i);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main() {
+    auto ok = true;
+
+    ok = runs_submitted_tasks_in_order() && ok;
+
+    printf("%s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,59 @@
+// Regression tests of `TimerWheel`. Exits with a non-zero status on failure.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include "timer_wheel.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static uint64_t ms_since(Clock::time_point start) {
+    return (uint64_t) std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+}
+
+static void sleep_until_ms(Clock::time_point start, uint64_t ms) {
+    std::this_thread::sleep_until(start + std::chrono::milliseconds(ms));
+}
+
+// An upper level timer must still fire on time while level 0 holds timers:
+// the cascade at the next level 0 wrap around mustn't wait for them.
+static bool upper_level_not_delayed_by_level_0() {
+    const uint64_t MS = 1000000;
+
+    std::atomic<uint64_t> fired { 0 };
+    auto start = Clock::now();
+
+    {
+        TimerWheel wheel([](TimerWheel::Task task) { task(); });
+
+        wheel.schedule(70 * MS, [&]() { fired = ms_since(start); });
+
+        sleep_until_ms(start, 52);
+        wheel.schedule(6 * MS, []() {});
+
+        sleep_until_ms(start, 55);
+        wheel.schedule(50 * MS, []() {});
+
+        sleep_until_ms(start, 120);
+    }
+
+    // Some slack for the scheduling of the test threads.
+    if (fired < 70 || fired > 85) {
+        printf("upper_level_not_delayed_by_level_0: fired at %llu ms, expected 70 ms\n",
+               (unsigned long long) fired.load());
+        return false;
+    }
+
+    return true;
+}
+
+int main() {
+    auto ok = true;
+
+    ok = upper_level_not_delayed_by_level_0() && ok;
+
+    printf("%s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,306 @@
+#ifndef _TIMER_WHEEL_H_
+#define _TIMER_WHEEL_H_
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Hierarchical timer wheel (Varghese and Lauck) for delayed and periodic tasks.
+// A single thread keeps time, in 1 ms ticks, and hands the due tasks to
+// `launch`, so a pending timer costs an entry instead of a sleeping thread.
+//
+// Level `k` has `SLOTS` slots of `SLOTS^k` ticks each. An entry sits on the
+// lowest level whose range covers its deadline and moves down a level each
+// time the level below wraps around, until it fires from level 0. Scheduling,
+// cancelling and firing are O(1); each entry is moved at most `LEVELS - 1`
+// times.
+class TimerWheel {
+public:
+    typedef std::function<void()> Task;
+
+    static const uint64_t TICK_NS = 1000000;
+    static const size_t LEVELS = 4;
+    static const size_t SLOT_BITS = 6;
+    static const size_t SLOTS = 1 << SLOT_BITS;
+
+    explicit TimerWheel(std::function<void(Task)> launch)
+        : launch(std::move(launch))
+        , start(Clock::now())
+        , thread([this]() { work(); })
+    {}
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator = (const TimerWheel&) = delete;
+
+    // The pending timers are dropped.
+    ~TimerWheel() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cond.notify_all();
+        thread.join();
+
+        // The cancelled entries are only referenced by their slot, the others
+        // also by `entries`.
+        for (auto& level : levels) {
+            for (auto& slot : level.slots) {
+                for (auto entry : slot) {
+                    if (entry->cancelled) {
+                        delete entry;
+                    }
+                }
+            }
+        }
+
+        for (auto& entry : entries) {
+            delete entry.second;
+        }
+    }
+
+    // Run `task` after `delay_ns` (rounded up to the tick), then every
+    // `period_ns` if it's not 0. Returns an id for `cancel`, never 0.
+    uint64_t schedule(uint64_t delay_ns, Task task, uint64_t period_ns = 0) {
+        auto entry = new Entry;
+        entry->task = std::move(task);
+        entry->period = (period_ns + TICK_NS - 1) / TICK_NS;
+
+        bool wake;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            entry->id = next_id++;
+            // Rounded up, so it never fires early.
+            auto deadline = (now_ns() + delay_ns + TICK_NS - 1) / TICK_NS;
+            entry->deadline = std::max(deadline, current + 1);
+
+            entries.emplace(entry->id, entry);
+            insert(entry);
+
+            wake = entry->deadline < wake_tick;
+        }
+
+        if (wake) {
+            cond.notify_all();
+        }
+
+        return entry->id;
+    }
+
+    // Returns false if the timer already fired (for the last time) or was
+    // cancelled. A task already handed to `launch` still runs.
+    bool cancel(uint64_t id) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto it = entries.find(id);
+        if (it == entries.end()) {
+            return false;
+        }
+
+        // Freed when its slot is next visited.
+        it->second->cancelled = true;
+        entries.erase(it);
+
+        return true;
+    }
+
+    // Block while the thread is handing tasks to `launch`. Once the launched
+    // tasks are known to be done, this ensures `launch` isn't in use anymore,
+    // e.g. before destroying what it launches into.
+    void sync() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&]() { return !launching; });
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Entry {
+        uint64_t id;
+        // In ticks since `start`.
+        uint64_t deadline;
+        uint64_t period;
+        Task task;
+        bool cancelled = false;
+    };
+
+    struct Level {
+        std::vector<Entry*> slots[SLOTS];
+        // Bit `i` is set if slot `i` is not empty.
+        uint64_t occupied = 0;
+    };
+
+    uint64_t now_ns() const {
+        return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - start).count();
+    }
+
+    // Must be called with `mutex` held, with `deadline >= current`.
+    void insert(Entry* entry) {
+        auto delta = entry->deadline - current;
+        auto deadline = entry->deadline;
+
+        size_t level = 0;
+        while (level + 1 < LEVELS && delta >= (uint64_t) 1 << (SLOT_BITS * (level + 1))) {
+            ++level;
+        }
+
+        // Beyond the range of the top level: parked in its last slot, and
+        // reinserted when that's reached.
+        if (delta >= (uint64_t) 1 << (SLOT_BITS * LEVELS)) {
+            deadline = current + ((uint64_t) 1 << (SLOT_BITS * LEVELS)) - 1;
+        }
+
+        auto slot = (deadline >> (SLOT_BITS * level)) & (SLOTS - 1);
+        levels[level].slots[slot].push_back(entry);
+        levels[level].occupied |= (uint64_t) 1 << slot;
+    }
+
+    // Move the entries of `level`'s current slot down. Returns true if the
+    // level wrapped around too, so the one above must be cascaded.
+    bool cascade(size_t level) {
+        auto slot = (current >> (SLOT_BITS * level)) & (SLOTS - 1);
+
+        std::vector<Entry*> moved;
+        moved.swap(levels[level].slots[slot]);
+        levels[level].occupied &= ~((uint64_t) 1 << slot);
+
+        for (auto entry : moved) {
+            if (entry->cancelled) {
+                delete entry;
+            } else {
+                insert(entry);
+            }
+        }
+
+        return slot == 0;
+    }
+
+    // Advance by one tick, collecting the due tasks. Must be called with
+    // `mutex` held.
+    void tick(std::vector<Task>& due) {
+        ++current;
+
+        if ((current & (SLOTS - 1)) == 0) {
+            for (size_t level = 1; level < LEVELS && cascade(level); ++level) {
+            }
+        }
+
+        auto slot = current & (SLOTS - 1);
+
+        std::vector<Entry*> fired;
+        fired.swap(levels[0].slots[slot]);
+        levels[0].occupied &= ~((uint64_t) 1 << slot);
+
+        for (auto entry : fired) {
+            if (entry->cancelled) {
+                delete entry;
+            } else if (entry->period > 0) {
+                due.push_back(entry->task);
+                entry->deadline += entry->period;
+                insert(entry);
+            } else {
+                due.push_back(std::move(entry->task));
+                entries.erase(entry->id);
+                delete entry;
+            }
+        }
+    }
+
+    // The next tick anything can happen at: a level 0 entry firing, or a
+    // cascade of the levels above, whichever comes first. `UINT64_MAX` if there
+    // are no entries.
+    uint64_t next_tick() const {
+        uint64_t next = UINT64_MAX;
+
+        if (levels[0].occupied != 0) {
+            // Rotate so that bit 0 is the slot of the next tick.
+            auto shift = (current + 1) & (SLOTS - 1);
+            auto rotated = shift == 0
+                         ? levels[0].occupied
+                         : (levels[0].occupied >> shift) | (levels[0].occupied << (SLOTS - shift));
+
+            next = current + 1 + __builtin_ctzll(rotated);
+        }
+
+        for (size_t level = 1; level < LEVELS; ++level) {
+            if (levels[level].occupied != 0) {
+                return std::min(next, (current | (SLOTS - 1)) + 1);
+            }
+        }
+
+        return next;
+    }
+
+    void work() {
+        std::vector<Task> due;
+        std::unique_lock<std::mutex> lock(mutex);
+
+        while (!stopping) {
+            auto now = now_ns() / TICK_NS;
+
+            while (current < now) {
+                // Nothing fires before level 0 wraps around, skip to it.
+                if (levels[0].occupied == 0) {
+                    current = std::min(now - 1, current | (SLOTS - 1));
+                }
+
+                tick(due);
+            }
+
+            if (!due.empty()) {
+                launching = true;
+                lock.unlock();
+
+                for (auto& task : due) {
+                    launch(std::move(task));
+                }
+                due.clear();
+
+                lock.lock();
+                launching = false;
+                cond.notify_all();
+                continue;
+            }
+
+            wake_tick = next_tick();
+
+            if (wake_tick == UINT64_MAX) {
+                cond.wait(lock);
+            } else {
+                cond.wait_until(lock, start + std::chrono::nanoseconds(wake_tick * TICK_NS));
+            }
+
+            wake_tick = 0;
+        }
+    }
+
+    std::function<void(Task)> launch;
+    const Clock::time_point start;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool stopping = false;
+    bool launching = false;
+
+    Level levels[LEVELS];
+    // The last tick processed.
+    uint64_t current = 0;
+    // The tick the thread sleeps until, 0 while it's awake.
+    uint64_t wake_tick = 0;
+
+    uint64_t next_id = 1;
+    // The pending entries, by id.
+    std::unordered_map<uint64_t, Entry*> entries;
+
+    std::thread thread;
+};
+
+#endif
@@ -0,0 +1,321 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "backend.h"
+
+// Tracing. Records are binary (a static format string plus up to
+// `TRACE_MAX_ARGS` arguments) and go into a lock-free ring owned by the
+// recording thread. A background thread formats them and writes them out, so
+// the recording thread never formats or flushes. When a ring is full the
+// record is dropped and counted.
+//
+// The background thread sleeps until a ring fills up to `WAKE_THRESHOLD` or an
+// error or info record is written. Other debug records are written out then,
+// or at the latest by `flush`, which runs at shutdown and exit.
+//
+// Levels above `BACKEND_TRACE_LEVEL` (by default info) are removed at compile
+// time.
+//
+// Format placeholders: `{}` integer, `{s}` static C string, `{key}` `Key`.
+
+#define TRACE_LEVEL_OFF   0
+#define TRACE_LEVEL_ERROR 1
+#define TRACE_LEVEL_INFO  2
+#define TRACE_LEVEL_DEBUG 3
+
+#ifndef BACKEND_TRACE_LEVEL
+#define BACKEND_TRACE_LEVEL TRACE_LEVEL_INFO
+#endif
+
+#define TRACE(level, ...)                                   \
+    do {                                                    \
+        if ((level) <= BACKEND_TRACE_LEVEL) {               \
+            Tracer::get().write((level), __VA_ARGS__);      \
+        }                                                   \
+    } while (0)
+
+#define TRACE_ERROR(...) TRACE(TRACE_LEVEL_ERROR, __VA_ARGS__)
+#define TRACE_INFO(...)  TRACE(TRACE_LEVEL_INFO, __VA_ARGS__)
+#define TRACE_DEBUG(...) TRACE(TRACE_LEVEL_DEBUG, __VA_ARGS__)
+
+const size_t TRACE_MAX_ARGS = 4;
+
+struct TraceRecord {
+    uint64_t timestamp_ns;
+    const char* format;
+    uint32_t level;
+    uint32_t arg_count;
+    uint64_t args[TRACE_MAX_ARGS];
+};
+
+inline uint64_t trace_arg(int64_t value)     { return (uint64_t) value; }
+inline uint64_t trace_arg(uint64_t value)    { return value; }
+inline uint64_t trace_arg(int32_t value)     { return (uint64_t) (int64_t) value; }
+inline uint64_t trace_arg(uint32_t value)    { return value; }
+inline uint64_t trace_arg(const char* value) { return (uint64_t) (uintptr_t) value; }
+
+inline uint64_t trace_arg(const Key& value) {
+    uint64_t output;
+    memcpy(&output, value.bytes, sizeof(output));
+    return output;
+}
+
+// Single producer (the owning thread), single consumer (the drainer) ring.
+struct TraceRing {
+    static const size_t CAPACITY = 1024;
+    static const size_t WAKE_THRESHOLD = CAPACITY / 2;
+
+    TraceRecord records[CAPACITY];
+    std::atomic<size_t> head { 0 };
+    std::atomic<size_t> tail { 0 };
+    std::atomic<uint64_t> dropped { 0 };
+    // Set when the owning thread exits; the drainer then frees the ring.
+    std::atomic<bool> closed { false };
+    size_t thread_index;
+
+    // Returns true if the ring has just filled up to `WAKE_THRESHOLD`.
+    bool push(const TraceRecord& record) {
+        auto h = head.load(std::memory_order_relaxed);
+        auto size = h - tail.load(std::memory_order_acquire);
+
+        if (size == CAPACITY) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        records[h % CAPACITY] = record;
+        head.store(h + 1, std::memory_order_release);
+        return size + 1 == WAKE_THRESHOLD;
+    }
+
+    template<typename F>
+    void drain(F f) {
+        auto t = tail.load(std::memory_order_relaxed);
+        auto h = head.load(std::memory_order_acquire);
+
+        for (; t != h; ++t) {
+            f(records[t % CAPACITY]);
+        }
+
+        tail.store(t, std::memory_order_release);
+    }
+};
+
+class Tracer {
+public:
+    // The tracer lives for the whole process: records may still be written
+    // while static destructors run.
+    static Tracer& get() {
+        static Tracer* instance = new Tracer;
+        return *instance;
+    }
+
+    template<typename... Args>
+    void write(uint32_t level, const char* format, const Args&... args) {
+        static_assert(sizeof...(Args) <= TRACE_MAX_ARGS, "Too many trace arguments");
+
+        TraceRecord record;
+        record.timestamp_ns = now_ns();
+        record.format = format;
+        record.level = level;
+        record.arg_count = sizeof...(Args);
+
+        uint64_t values[] = { 0, trace_arg(args)... };
+        memcpy(record.args, values + 1, sizeof...(Args) * sizeof(uint64_t));
+
+        if (local().push(record) || level <= TRACE_LEVEL_INFO) {
+            wake();
+        }
+    }
+
+    // Redirect the output to the file at `path`. Returns false if it can't be
+    // opened.
+    bool open(const char* path) {
+        auto file = fopen(path, "a");
+        if (!file) {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(drain_mutex);
+
+        if (out != stdout) {
+            fclose(out);
+        }
+
+        out = file;
+        return true;
+    }
+
+    // Write out everything recorded so far.
+    void flush() {
+        std::lock_guard<std::mutex> lock(drain_mutex);
+        drain();
+    }
+
+private:
+    Tracer() : start_ns(now_ns()) {
+        auto path = getenv("BACKEND_TRACE_FILE");
+        if (path) {
+            out = fopen(path, "a");
+        }
+
+        if (!out) {
+            out = stdout;
+        }
+
+        std::atexit([]() { Tracer::get().flush(); });
+
+        std::thread([this]() {
+            for (;;) {
+                {
+                    std::unique_lock<std::mutex> lock(wake_mutex);
+                    wake_cond.wait(lock, [this]() { return wake_pending; });
+                    wake_pending = false;
+                }
+
+                flush();
+            }
+        }).detach();
+    }
+
+    // Have the background thread write out the records.
+    void wake() {
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex);
+            wake_pending = true;
+        }
+        wake_cond.notify_one();
+    }
+
+    static uint64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Closes the ring of the thread when it exits.
+    struct RingOwner {
+        TraceRing* ring = nullptr;
+
+        ~RingOwner() {
+            if (ring) {
+                ring->closed.store(true, std::memory_order_release);
+            }
+        }
+    };
+
+    TraceRing& local() {
+        thread_local RingOwner owner;
+
+        if (!owner.ring) {
+            owner.ring = new TraceRing;
+
+            std::lock_guard<std::mutex> lock(rings_mutex);
+            owner.ring->thread_index = next_thread_index++;
+            rings.push_back(owner.ring);
+        }
+
+        return *owner.ring;
+    }
+
+    // Must be called with `drain_mutex` held.
+    void drain() {
+        std::vector<TraceRing*> current;
+
+        {
+            std::lock_guard<std::mutex> lock(rings_mutex);
+            current = rings;
+        }
+
+        for (auto ring : current) {
+            auto closed = ring->closed.load(std::memory_order_acquire);
+
+            ring->drain([&](const TraceRecord& record) {
+                print(ring->thread_index, record);
+            });
+
+            auto dropped = ring->dropped.exchange(0, std::memory_order_relaxed);
+            if (dropped > 0) {
+                fprintf(out, "- C: [thread %zu] %llu trace records dropped\n",
+                        ring->thread_index,
+                        (unsigned long long) dropped);
+            }
+
+            if (closed) {
+                std::lock_guard<std::mutex> lock(rings_mutex);
+                rings.erase(std::find(rings.begin(), rings.end(), ring));
+                delete ring;
+            }
+        }
+
+        fflush(out);
+    }
+
+    void print(size_t thread_index, const TraceRecord& record) {
+        static const char* levels[] = { "", "ERROR", "INFO", "DEBUG" };
+
+        fprintf(out,
+                "- C: [%10.3f ms] [%s] [thread %zu] ",
+                (record.timestamp_ns - start_ns) / 1e6,
+                levels[record.level],
+                thread_index);
+
+        auto arg = record.args;
+        auto end = record.args + record.arg_count;
+
+        for (auto p = record.format; *p; ++p) {
+            if (*p == '{' && arg != end) {
+                if (strncmp(p, "{}", 2) == 0) {
+                    fprintf(out, "%lld", (long long) *arg++);
+                    p += 1;
+                    continue;
+                } else if (strncmp(p, "{s}", 3) == 0) {
+                    fputs((const char*) (uintptr_t) *arg++, out);
+                    p += 2;
+                    continue;
+                } else if (strncmp(p, "{key}", 5) == 0) {
+                    Key key;
+                    memcpy(key.bytes, arg++, sizeof(key.bytes));
+
+                    fputc('[', out);
+                    for (auto b : key.bytes) {
+                        fprintf(out, "%d, ", (int) b);
+                    }
+                    fputc(']', out);
+
+                    p += 4;
+                    continue;
+                }
+            }
+
+            fputc(*p, out);
+        }
+
+        fputc('\n', out);
+    }
+
+    FILE* out = nullptr;
+    uint64_t start_ns;
+
+    std::mutex drain_mutex;
+
+    std::mutex wake_mutex;
+    std::condition_variable wake_cond;
+    bool wake_pending = false;
+
+    std::mutex rings_mutex;
+    std::vector<TraceRing*> rings;
+    size_t next_thread_index = 0;
+};
+
+#endif
@@ -0,0 +1,86 @@
+using System;
+using System.Diagnostics;
+using System.Globalization;
+using System.IO;
+using System.Threading;
+
+// Benchmarks the hand-coded P/Invoke bindings (`hand-coded-csharp`). Those only
+// cover `register_app`, `get_app_id` and `get_app_name`.
+public class Bench {
+    // Maximum number of calls in flight while measuring throughput.
+    const int Window = 64;
+
+    static StreamWriter output;
+
+    public static void Main(string[] args) {
+        output = new StreamWriter(args[0]);
+
+        var key = new Key();
+        key.bytes = new byte[] { 1, 2, 3, 5, 7, 11, 13, 17 };
+
+        var app = new AppInfo();
+        app.id = 1234;
+        app.name = "Unique-App";
+        app.key = key;
+
+        Measure("register_app", 20000, (done) => {
+            NativeBindings.RegisterApp(app, (result) => done());
+        });
+
+        Measure("get_app_id", 20000, (done) => {
+            NativeBindings.GetAppId(app, (result, res) => done());
+        });
+
+        Measure("get_app_name", 20000, (done) => {
+            NativeBindings.GetAppName(app, (result, res) => done());
+        });
+
+        output.Close();
+    }
+
+    static void Measure(string op, int iterations, Action<Action> body) {
+        Throughput(iterations / 10 + 1, body);
+
+        var latencies = new double[iterations];
+        var done = new SemaphoreSlim(0);
+
+        for (var i = 0; i < iterations; ++i) {
+            var start = Stopwatch.GetTimestamp();
+            body(() => done.Release());
+            done.Wait();
+            latencies[i] = (Stopwatch.GetTimestamp() - start) * 1e6 / Stopwatch.Frequency;
+        }
+
+        var opsPerSec = Throughput(iterations, body);
+
+        Array.Sort(latencies);
+
+        output.WriteLine(String.Format(
+            CultureInfo.InvariantCulture,
+            "{{\"binding\": \"csharp\", \"op\": \"{0}\", \"payload\": 0, "
+            + "\"iterations\": {1}, \"ops_per_sec\": {2:F1}, "
+            + "\"p50_us\": {3:F2}, \"p99_us\": {4:F2}}}",
+            op,
+            iterations,
+            opsPerSec,
+            latencies[latencies.Length * 50 / 100],
+            latencies[latencies.Length * 99 / 100]));
+        output.Flush();
+    }
+
+    static double Throughput(int iterations, Action<Action> body) {
+        var window = new SemaphoreSlim(Window);
+        var stopwatch = Stopwatch.StartNew();
+
+        for (var i = 0; i < iterations; ++i) {
+            window.Wait();
+            body(() => window.Release());
+        }
+
+        for (var i = 0; i < Window; ++i) {
+            window.Wait();
+        }
+
+        return iterations / stopwatch.Elapsed.TotalSeconds;
+    }
+}
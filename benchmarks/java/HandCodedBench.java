@@ -0,0 +1,71 @@
+import java.nio.ByteBuffer;
+
+// Benchmarks the hand-coded JNI bindings (`hand-coded-java`). The same classes
+// are backed either by the C++ or the Rust native library; the first argument
+// names which one is loaded.
+class HandCodedBench {
+    public static void main(String args[]) throws Exception {
+        Harness harness = new Harness(args[0], args[1]);
+
+        Key appKey = new Key();
+        appKey.bytes = new byte[] { 1, 2, 3, 5, 7, 11, 13, 17 };
+
+        AppInfo app = new AppInfo();
+        app.id = 1234;
+        app.name = "Unique-App";
+        app.key = appKey;
+
+        harness.measure("register_app", 0, 20000, (done) -> {
+            NativeBindings.registerApp(app, (result) -> done.run());
+        });
+
+        harness.measure("get_app_id", 0, 20000, (done) -> {
+            NativeBindings.getAppId(app, (result, arg) -> done.run());
+        });
+
+        harness.measure("get_app_name", 0, 20000, (done) -> {
+            NativeBindings.getAppName(app, (result, arg) -> done.run());
+        });
+
+        harness.measure("random_keys", 0, 20000, (done) -> {
+            NativeBindings.randomKeys((result, arg) -> done.run());
+        });
+
+        for (int size : new int[] { 1 << 10, 1 << 16, 1 << 20, 1 << 24 }) {
+            byte[] data = new byte[size];
+            data[size - 1] = 1;
+
+            int iterations = Math.max(50, (1 << 24) / size);
+
+            harness.measure("verify_signature", size, iterations, (done) -> {
+                NativeBindings.verifySignature(data, (result) -> done.run());
+            });
+
+            ByteBuffer direct = ByteBuffer.allocateDirect(size);
+            direct.put(size - 1, (byte) 1);
+
+            harness.measure("verify_signature_direct", size, iterations, (done) -> {
+                NativeBindings.verifySignature(direct, (result) -> done.run());
+            });
+        }
+
+        Key[] keys = new Key[1024];
+        for (int i = 0; i < keys.length; ++i) {
+            keys[i] = new Key();
+            keys[i].bytes = new byte[] { 1, 1, 1, 1, 1, 1, 1, 1 };
+        }
+
+        harness.measure("verify_keys", keys.length, 2000, (done) -> {
+            NativeBindings.verifyKeys(keys, (result) -> done.run());
+        });
+
+        KeyArray packed = KeyArray.of(keys);
+
+        harness.measure("verify_keys_packed", packed.size(), 2000, (done) -> {
+            NativeBindings.verifyKeysPacked(packed, (result) -> done.run());
+        });
+
+        harness.close();
+        NativeBindings.backendShutdown();
+    }
+}
@@ -0,0 +1,75 @@
+import java.io.FileWriter;
+import java.io.IOException;
+import java.io.PrintWriter;
+import java.util.Arrays;
+import java.util.concurrent.Semaphore;
+
+// Minimal JMH-style harness for the asynchronous bindings: warms up, measures the
+// round-trip latency (call to callback) of sequential calls, then the
+// throughput with a bounded number of calls in flight. Each measurement is
+// written as one JSON line.
+public class Harness {
+    // Maximum number of calls in flight while measuring throughput.
+    public static final int WINDOW = 64;
+
+    // One benchmarked call. Must eventually run `done` from the callback.
+    public interface Op {
+        void call(Runnable done);
+    }
+
+    private final String binding;
+    private final PrintWriter out;
+
+    public Harness(String binding, String outPath) throws IOException {
+        this.binding = binding;
+        this.out = new PrintWriter(new FileWriter(outPath));
+    }
+
+    public void measure(String op, long payload, int iterations, Op body) {
+        throughput(iterations / 10 + 1, body);
+
+        double[] latencies = new double[iterations];
+        Semaphore done = new Semaphore(0);
+
+        for (int i = 0; i < iterations; ++i) {
+            long start = System.nanoTime();
+            body.call(done::release);
+            done.acquireUninterruptibly();
+            latencies[i] = (System.nanoTime() - start) / 1000.0;
+        }
+
+        double opsPerSec = throughput(iterations, body);
+
+        Arrays.sort(latencies);
+
+        out.printf("{\"binding\": \"%s\", \"op\": \"%s\", \"payload\": %d, "
+                   + "\"iterations\": %d, \"ops_per_sec\": %.1f, "
+                   + "\"p50_us\": %.2f, \"p99_us\": %.2f}%n",
+                   binding,
+                   op,
+                   payload,
+                   iterations,
+                   opsPerSec,
+                   latencies[latencies.length * 50 / 100],
+                   latencies[latencies.length * 99 / 100]);
+        out.flush();
+    }
+
+    public void close() {
+        out.close();
+    }
+
+    private double throughput(int iterations, Op body) {
+        Semaphore window = new Semaphore(WINDOW);
+        long start = System.nanoTime();
+
+        for (int i = 0; i < iterations; ++i) {
+            window.acquireUninterruptibly();
+            body.call(window::release);
+        }
+
+        window.acquireUninterruptibly(WINDOW);
+
+        return iterations / ((System.nanoTime() - start) / 1e9);
+    }
+}
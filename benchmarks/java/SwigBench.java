@@ -0,0 +1,55 @@
+import java.util.Arrays;
+
+// Benchmarks the bindings generated by SWIG with custom typemaps
+// (`swig-gen-typemaps`).
+class SwigBench {
+    public static void main(String args[]) throws Exception {
+        Harness harness = new Harness("swig-typemaps", args[0]);
+
+        AppInfo app = new AppInfo();
+        app.id = 1234;
+        app.name = "Unique-App";
+        app.key = new Key();
+        app.key.bytes = new byte[] { 1, 2, 3, 5, 7, 11, 13, 17 };
+
+        harness.measure("register_app", 0, 20000, (done) -> {
+            NativeBindings.registerApp(app, (result) -> done.run());
+        });
+
+        harness.measure("get_app_id", 0, 20000, (done) -> {
+            NativeBindings.getAppId(app, (result, res) -> done.run());
+        });
+
+        harness.measure("get_app_name", 0, 20000, (done) -> {
+            NativeBindings.getAppName(app, (result, res) -> done.run());
+        });
+
+        harness.measure("random_keys", 0, 20000, (done) -> {
+            NativeBindings.randomKeys((result, res) -> done.run());
+        });
+
+        for (int size : new int[] { 1 << 10, 1 << 16, 1 << 20, 1 << 24 }) {
+            byte[] data = new byte[size];
+            data[size - 1] = 1;
+
+            int iterations = Math.max(50, (1 << 24) / size);
+
+            harness.measure("verify_signature", size, iterations, (done) -> {
+                NativeBindings.verifySignature(data, (result) -> done.run());
+            });
+        }
+
+        KeyArray keys = new KeyArray(1024);
+        byte[] bytes = new byte[keys.size() * Key.SIZE];
+        Arrays.fill(bytes, (byte) 1);
+        keys.buffer.put(bytes);
+        keys.buffer.rewind();
+
+        harness.measure("verify_keys", keys.size(), 2000, (done) -> {
+            NativeBindings.verifyKeys(keys, (result) -> done.run());
+        });
+
+        harness.close();
+        NativeBindings.backendShutdown();
+    }
+}
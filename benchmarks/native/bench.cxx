@@ -0,0 +1,178 @@
+// Native-only baseline: calls the backend directly, with no binding layer in
+// between. Results are written as JSON lines to the file given as the first
+// argument.
+
+#include "backend.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// Maximum number of calls in flight while measuring throughput.
+static const size_t WINDOW = 64;
+
+// Counts completed calls and lets the driver wait for them.
+struct Completions {
+    std::mutex mutex;
+    std::condition_variable cond;
+    size_t count = 0;
+
+    // Notifies under the lock: once the driver sees the count it may return
+    // and destroy this object, so nothing may touch it after the unlock.
+    void signal() {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++count;
+        cond.notify_all();
+    }
+
+    void wait_for(size_t target) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&]() { return count >= target; });
+    }
+};
+
+void on_void(void* ctx, const FfiResult*) {
+    ((Completions*) ctx)->signal();
+}
+
+void on_i32(void* ctx, const FfiResult*, int32_t) {
+    ((Completions*) ctx)->signal();
+}
+
+void on_string(void* ctx, const FfiResult*, const char*) {
+    ((Completions*) ctx)->signal();
+}
+
+void on_Key_array(void* ctx, const FfiResult*, const Key*, size_t) {
+    ((Completions*) ctx)->signal();
+}
+
+using Op = std::function<void(void* ctx)>;
+
+class Driver {
+public:
+    explicit Driver(FILE* out) : out(out) {}
+
+    void measure(const char* op, size_t payload, size_t iterations, Op body) {
+        // Warm up.
+        throughput(iterations / 10 + 1, body);
+
+        std::vector<double> latencies;
+        latencies.reserve(iterations);
+
+        {
+            Completions completions;
+
+            for (size_t i = 0; i < iterations; ++i) {
+                auto start = Clock::now();
+                body(&completions);
+                completions.wait_for(i + 1);
+
+                latencies.push_back(
+                    std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+            }
+        }
+
+        auto ops_per_sec = throughput(iterations, body);
+
+        std::sort(latencies.begin(), latencies.end());
+
+        fprintf(out,
+                "{\"binding\": \"native\", \"op\": \"%s\", \"payload\": %zu, "
+                "\"iterations\": %zu, \"ops_per_sec\": %.1f, "
+                "\"p50_us\": %.2f, \"p99_us\": %.2f}\n",
+                op,
+                payload,
+                iterations,
+                ops_per_sec,
+                latencies[latencies.size() * 50 / 100],
+                latencies[latencies.size() * 99 / 100]);
+        fflush(out);
+    }
+
+private:
+    double throughput(size_t iterations, const Op& body) {
+        Completions completions;
+        auto start = Clock::now();
+
+        for (size_t i = 0; i < iterations; ++i) {
+            if (i >= WINDOW) {
+                completions.wait_for(i - WINDOW + 1);
+            }
+
+            body(&completions);
+        }
+
+        completions.wait_for(iterations);
+
+        return iterations / std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    FILE* out;
+};
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <output-file>\n", argv[0]);
+        return 1;
+    }
+
+    FILE* out = fopen(argv[1], "w");
+    if (!out) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    Driver driver(out);
+
+    AppInfo app_info = {
+        .id = 1234,
+        .name = (char*) "Unique-App",
+        .key = Key {{ 1, 2, 3, 5, 7, 11, 13, 17 }}
+    };
+
+    driver.measure("register_app", 0, 20000, [&](void* ctx) {
+        register_app(&app_info, ctx, on_void);
+    });
+
+    driver.measure("get_app_id", 0, 20000, [&](void* ctx) {
+        get_app_id(&app_info, ctx, on_i32);
+    });
+
+    driver.measure("get_app_name", 0, 20000, [&](void* ctx) {
+        get_app_name(&app_info, ctx, on_string);
+    });
+
+    driver.measure("random_keys", 0, 20000, [&](void* ctx) {
+        random_keys(ctx, on_Key_array);
+    });
+
+    for (size_t size : { 1 << 10, 1 << 16, 1 << 20, 1 << 24 }) {
+        std::vector<uint8_t> data(size, 0);
+        data.back() = 1;
+
+        auto iterations = std::max<size_t>(50, (1 << 24) / size);
+
+        driver.measure("verify_signature", size, iterations, [&](void* ctx) {
+            verify_signature(data.data(), data.size(), ctx, on_void);
+        });
+    }
+
+    std::vector<Key> keys(1024, Key {{ 1, 1, 1, 1, 1, 1, 1, 1 }});
+
+    driver.measure("verify_keys", keys.size(), 2000, [&](void* ctx) {
+        verify_keys(keys.data(), keys.size(), ctx, on_void);
+    });
+
+    backend_shutdown();
+    fclose(out);
+
+    return 0;
+}
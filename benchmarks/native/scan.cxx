@@ -0,0 +1,119 @@
+// Signature verification kernel microbenchmark. Scans all-zero buffers (the
+// worst case: no early exit) with the previous `std::any_of` implementation and
+// each kernel the CPU supports, single-threaded, then through
+// `verify_signature_borrowed`, which splits large inputs over the pool.
+// Results are written as JSON lines to the file given as the first argument.
+
+#include "backend.h"
+#include "scan.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+bool scan_any_of(const uint8_t* ptr, size_t len) {
+    return std::any_of(ptr, ptr + len, [](uint8_t e) { return e != 0; });
+}
+
+// Keeps the scans from being optimized out.
+volatile bool sink;
+
+// Best of a few runs, in GB/s.
+template<typename F>
+double measure(size_t size, size_t iterations, F scan) {
+    double best = 0;
+
+    for (int run = 0; run < 5; ++run) {
+        auto start = Clock::now();
+
+        for (size_t i = 0; i < iterations; ++i) {
+            sink = scan();
+        }
+
+        std::chrono::duration<double> elapsed = Clock::now() - start;
+        best = std::max(best, size * iterations / elapsed.count() / 1e9);
+    }
+
+    return best;
+}
+
+struct Done {
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool done = false;
+};
+
+void on_done(void* ctx, const FfiResult*) {
+    auto done = (Done*) ctx;
+
+    // Under the lock, as the waiter destroys `done` as soon as it sees it set.
+    std::lock_guard<std::mutex> lock(done->mutex);
+    done->done = true;
+    done->cond.notify_one();
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <output-file>\n", argv[0]);
+        return 1;
+    }
+
+    auto out = fopen(argv[1], "w");
+    if (!out) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    auto threads = std::max(1u, std::thread::hardware_concurrency());
+    backend_init(threads);
+
+    ScanKernelInfo kernels[4];
+    auto kernel_count = scan_kernels(kernels);
+
+    auto report = [&](const char* kernel, size_t size, size_t cores, double gb_per_sec) {
+        fprintf(out,
+                "{\"bench\": \"scan\", \"kernel\": \"%s\", \"size\": %zu, "
+                "\"cores\": %zu, \"gb_per_sec\": %.2f, \"gb_per_sec_per_core\": %.2f}\n",
+                kernel,
+                size,
+                cores,
+                gb_per_sec,
+                gb_per_sec / cores);
+        fflush(out);
+    };
+
+    for (size_t size : { 1 << 12, 1 << 16, 1 << 20, 1 << 24, 1 << 28 }) {
+        std::vector<uint8_t> data(size, 0);
+        auto iterations = std::max<size_t>(4, (1 << 28) / size);
+
+        report("any_of", size, 1, measure(size, iterations, [&]() {
+            return scan_any_of(data.data(), size);
+        }));
+
+        for (size_t k = 0; k < kernel_count; ++k) {
+            report(kernels[k].name, size, 1, measure(size, iterations, [&]() {
+                return kernels[k].kernel(data.data(), size);
+            }));
+        }
+
+        report("backend", size, threads, measure(size, iterations, [&]() {
+            Done done;
+            verify_signature_borrowed(data.data(), size, &done, on_done);
+
+            std::unique_lock<std::mutex> lock(done.mutex);
+            done.cond.wait(lock, [&]() { return done.done; });
+            return done.done;
+        }));
+    }
+
+    backend_shutdown();
+    fclose(out);
+
+    return 0;
+}
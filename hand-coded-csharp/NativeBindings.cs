@@ -29,34 +29,40 @@ public struct AppInfo {
 
 
 public class NativeBindings {
-    private delegate void Callback0(IntPtr ctx, ref FfiResult result);
-    private delegate void Callback1<T>(IntPtr ctx, ref FfiResult result, T arg);
+    private delegate void Callback0(IntPtr ctx, [In] ref FfiResult result);
+    private delegate void Callback1<T>(IntPtr ctx, [In] ref FfiResult result, T arg);
+
+    // The backend calls these from its own threads after the P/Invoke returned,
+    // so the delegates must be kept alive for the whole program.
+    private static readonly Callback0 call0 = Call0;
+    private static readonly Callback1<int> call1Int = Call1<int>;
+    private static readonly Callback1<String> call1String = Call1<String>;
 
     public static void RegisterApp(AppInfo appInfo, Action<FfiResult> cb) {
         var ctx = GCHandle.ToIntPtr(GCHandle.Alloc(cb));
-        register_app(ref appInfo, ctx, new Callback0(Call0));
+        register_app(ref appInfo, ctx, call0);
     }
 
     public static void GetAppId(AppInfo appInfo, Action<FfiResult, int> cb) {
         var ctx = GCHandle.ToIntPtr(GCHandle.Alloc(cb));
-        get_app_id(ref appInfo, ctx, new Callback1<int>(Call1<int>));
+        get_app_id(ref appInfo, ctx, call1Int);
     }
 
     public static void GetAppName(AppInfo appInfo, Action<FfiResult, String> cb) {
         var ctx = GCHandle.ToIntPtr(GCHandle.Alloc(cb));
-        get_app_name(ref appInfo, ctx, new Callback1<String>(Call1<String>));
+        get_app_name(ref appInfo, ctx, call1String);
     }
 
     // ---------------------
 
-    private static void Call0(IntPtr ctx, ref FfiResult result) {
+    private static void Call0(IntPtr ctx, [In] ref FfiResult result) {
         var handle = GCHandle.FromIntPtr(ctx);
         var cb = (Action<FfiResult>) handle.Target;
         cb(result);
         handle.Free();
     }
 
-    private static void Call1<T>(IntPtr ctx, ref FfiResult result, T arg) {
+    private static void Call1<T>(IntPtr ctx, [In] ref FfiResult result, T arg) {
         var handle = GCHandle.FromIntPtr(ctx);
         var cb = (Action<FfiResult, T>) handle.Target;
         cb(result, arg);
@@ -8,8 +8,11 @@
 %include "csharp/arrays_csharp.i"
 
 // We can use C# naming convention:
+%rename(BackendInit)     backend_init;
+%rename(BackendShutdown) backend_shutdown;
 %rename(CreateAccount)   create_account;
 %rename(CreateAccount2)  create_account_2;
+%rename(FindInvalidKeys) find_invalid_keys;
 %rename(GetAppId)        get_app_id;
 %rename(GetAppInfo)      get_app_info;
 %rename(GetAppKey)       get_app_key;
@@ -20,4 +23,26 @@
 %rename(VerifyKeys)      verify_keys;
 %rename(VerifySignature) verify_signature;
 
+%rename(VerifySignatureBegin)  verify_signature_begin;
+%rename(VerifySignatureUpdate) verify_signature_update;
+%rename(VerifySignatureFinish) verify_signature_finish;
+%rename(VerifySignatureFile)   verify_signature_file;
+%rename(VerifyKeysFile)        verify_keys_file;
+
+%rename(SetLimits)          backend_set_limits;
+%rename(SetAdmissionPolicy) backend_set_admission_policy;
+%rename(GetAdmission)       backend_get_admission;
+
+// The borrowed input must outlive the call, which the array typemaps can't
+// guarantee.
+%ignore verify_signature_borrowed;
+
+// No typemaps for output buffers yet.
+%ignore random_numbers_fill;
+%ignore random_keys_fill;
+
+// No typemaps for input arrays of AppInfo yet.
+%ignore register_apps;
+%ignore get_app_infos;
+
 %include "backend.h"
@@ -1,7 +1,10 @@
+import java.nio.ByteBuffer;
 import java.util.Arrays;
 
 class Frontend {
     public static void main(String args[]) {
+        NativeBindings.backendInit(4);
+
         Key appKey = new Key();
         appKey.bytes = new byte[] { 1, 2, 3, 5, 7, 11, 13, 17 };
 
@@ -49,6 +52,23 @@ class Frontend {
 
         // ---
 
+        NativeBindings.randomKeysPacked((result, arg) -> {
+            System.out.println("- Java: randomKeysPacked():");
+            for (int i = 0; i < arg.size(); ++i) {
+                System.out.println("    " + i + ": " + Arrays.toString(arg.get(i).bytes));
+            }
+        });
+
+        int[] numbers = new int[8];
+        NativeBindings.randomNumbers(42, numbers);
+        System.out.println("- Java: randomNumbers(42): " + Arrays.toString(numbers));
+
+        KeyArray generated = new KeyArray(2);
+        NativeBindings.randomKeys(42, generated);
+        System.out.println("- Java: randomKeys(42): " + Arrays.toString(generated.bytes));
+
+        // ---
+
         NativeBindings.getAppInfo(app, (result, id, name, key) -> {
             System.out.println("- Java: getAppInfo(): { id: " + id
                                + ", name: " + name
@@ -74,6 +94,42 @@ class Frontend {
 
         // ---
 
+        NativeBindings.createAccount2("my_locator2", "my_password2", (result, events) -> {
+            for (CreateAccountEvent event : events) {
+                if (event.type == CreateAccountEvent.CONNECT) {
+                    System.out.println(
+                          "- Java: createAccount2() [connect]: { id: " + event.appInfo.id
+                        + ", name: " + event.appInfo.name
+                        + ", key: " + Arrays.toString(event.appInfo.key.bytes)
+                        + " }"
+                    );
+                } else {
+                    System.out.println("- Java: createAccount2() [disconnect]");
+                }
+            }
+        });
+
+        // ---
+
+        AppInfo[] apps = new AppInfo[] { app, app, app };
+
+        NativeBindings.registerApps(apps, (result, codes) -> {
+            System.out.println("- Java: registerApps(): " + Arrays.toString(codes));
+        });
+
+        NativeBindings.getAppInfos(apps, (result, codes, ids, names, keys) -> {
+            System.out.println("- Java: getAppInfos():");
+            for (int i = 0; i < codes.length; ++i) {
+                System.out.println("    " + i + ": { code: " + codes[i]
+                                   + ", id: " + ids[i]
+                                   + ", name: " + names[i]
+                                   + ", key: " + Arrays.toString(keys.get(i).bytes)
+                                   + " }");
+            }
+        });
+
+        // ---
+
         byte[] data1 = new byte[] { 0, 0, 0, 0, 0, 0, 0, 0 };
         byte[] data2 = new byte[] { 1, 1, 1, 2, 1, 1, 2, 1 };
 
@@ -85,6 +141,27 @@ class Frontend {
             System.out.println("- Java: verifySignature(): " + result.error);
         });
 
+        ByteBuffer data3 = ByteBuffer.allocateDirect(1024 * 1024);
+        data3.put(data3.capacity() - 1, (byte) 1);
+
+        NativeBindings.verifySignature(data3, (result) -> {
+            System.out.println("- Java: verifySignature() [direct]: " + result.error);
+        });
+
+        // The same buffer, refilled for each chunk.
+        VerifySession session = NativeBindings.verifySignatureBegin();
+        ByteBuffer chunk = ByteBuffer.allocateDirect(64 * 1024);
+
+        for (int i = 0; i < 16; ++i) {
+            chunk.clear();
+            chunk.put(chunk.capacity() - 1, (byte) (i == 15 ? 1 : 0));
+            NativeBindings.verifySignatureUpdate(session, chunk);
+        }
+
+        NativeBindings.verifySignatureFinish(session, (result) -> {
+            System.out.println("- Java: verifySignature() [streaming]: " + result.error);
+        });
+
         // ---
 
         Key key0 = new Key();
@@ -102,7 +179,56 @@ class Frontend {
             System.out.println("- Java: verifyKeys()");
         });
 
+        NativeBindings.verifyKeysPacked(KeyArray.of(keys), (result) -> {
+            System.out.println("- Java: verifyKeysPacked()");
+        });
+
+        NativeBindings.findInvalidKeysPacked(KeyArray.of(keys), (result, indices) -> {
+            System.out.println("- Java: findInvalidKeysPacked(): " + Arrays.toString(indices));
+        });
+
+        // ---
+
+        NativeBindings.completionQueueInit(1024);
+
+        NativeBindings.registerAppPolled(app, 1);
+        NativeBindings.getAppIdPolled(app, 2);
+        NativeBindings.getAppKeyPolled(app, 3);
+        NativeBindings.verifySignaturePolled(data2, 4);
+
+        CompletionBuffer completions = new CompletionBuffer(16);
+        int received = 0;
+
+        while (received < 4) {
+            completions.poll();
+
+            for (int i = 0; i < completions.count; ++i) {
+                System.out.println("- Java: completion " + completions.requestId(i)
+                                   + ": error code " + completions.errorCode(i)
+                                   + ", payload length " + completions.payloadLength(i));
+            }
+
+            received += completions.count;
+            Thread.yield();
+        }
+
         try { Thread.sleep(5000); } catch(InterruptedException e) {}
+
+        for (OpStats stats : NativeBindings.getStats()) {
+            System.out.println("- Java: stats: " + stats.name
+                               + ": count " + stats.count
+                               + ", queue " + stats.totalNanos[OpStats.QUEUE] + " ns"
+                               + ", execute " + stats.totalNanos[OpStats.EXECUTE] + " ns"
+                               + ", marshal " + stats.totalNanos[OpStats.MARSHAL] + " ns"
+                               + ", upcall " + stats.totalNanos[OpStats.UPCALL] + " ns");
+        }
+
+        AdmissionStats admission = NativeBindings.getAdmission();
+        System.out.println("- Java: admission: " + admission.requests + " in flight"
+                           + ", " + admission.queued + " queued"
+                           + ", " + admission.rejected + " rejected");
+
+        NativeBindings.backendShutdown();
         System.out.println("- Java: Exiting Frontend");
     }
 }
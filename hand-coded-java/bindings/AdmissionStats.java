@@ -0,0 +1,18 @@
+// Admission limits and occupancy of the backend, see `NativeBindings.getAdmission`.
+public class AdmissionStats {
+    // Policies for calls over the limits, see `NativeBindings.setAdmissionPolicy`.
+    public static final int BLOCK     = 0; // block the caller until the call fits
+    public static final int FAIL_FAST = 1; // call the callback with `FfiResult.ERROR_OVERLOADED`
+    public static final int QUEUE     = 2; // start the call once it fits
+
+    // 0 means no limit.
+    public long maxRequests;
+    public long maxBytes;
+
+    public long requests;
+    public long bytes;
+    // Calls accepted but waiting to start.
+    public long queued;
+    // Total calls failed with `FfiResult.ERROR_OVERLOADED`.
+    public long rejected;
+}
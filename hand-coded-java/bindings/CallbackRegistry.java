@@ -0,0 +1,112 @@
+import java.util.Arrays;
+
+// Callbacks of the requests in flight. The native side gets a handle instead of
+// a global ref to the callback, and looks the callback up here when the request
+// completes.
+//
+// A handle is the slot index (low 32 bits) tagged with the generation of the
+// slot (high 32 bits). The generation changes every time the slot is released,
+// so a stale or repeated handle resolves to nothing instead of to another
+// request's callback. Released slots are reused, so once the table has grown to
+// the peak number of requests in flight, registering doesn't allocate.
+public final class CallbackRegistry {
+    // A slot holds up to this many objects: the callbacks of the request, or a
+    // callback and an object that has to stay reachable until it's called.
+    public static final int SLOT_SIZE = 2;
+
+    private static Object[] objects = new Object[64 * SLOT_SIZE];
+    private static int[] generations = new int[64];
+    // Number of objects in each slot not taken yet.
+    private static int[] pending = new int[64];
+
+    private static int[] free = new int[64];
+    private static int freeCount = 0;
+
+    static {
+        release(0, generations.length);
+    }
+
+    private CallbackRegistry() {}
+
+    public static long register(Object object) {
+        return register(object, null);
+    }
+
+    public static synchronized long register(Object object0, Object object1) {
+        if (freeCount == 0) {
+            grow();
+        }
+
+        int slot = free[--freeCount];
+
+        objects[slot * SLOT_SIZE] = object0;
+        objects[slot * SLOT_SIZE + 1] = object1;
+        pending[slot] = object1 != null ? 2 : 1;
+
+        return ((long) generations[slot] << 32) | slot;
+    }
+
+    // Removes object `index` of the slot and returns it, or returns null if the
+    // handle is stale or the object was already taken. The slot is released when
+    // its last object is taken. Called from the native side.
+    public static synchronized Object take(long handle, int index) {
+        int slot = (int) handle;
+        int generation = (int) (handle >>> 32);
+
+        if (slot < 0 || slot >= generations.length || generations[slot] != generation) {
+            return null;
+        }
+
+        Object output = objects[slot * SLOT_SIZE + index];
+        if (output == null) {
+            return null;
+        }
+
+        objects[slot * SLOT_SIZE + index] = null;
+
+        if (--pending[slot] == 0) {
+            generations[slot] += 1;
+            free[freeCount++] = slot;
+        }
+
+        return output;
+    }
+
+    // Returns object `index` of the slot without removing it, or null if the
+    // handle is stale or the object was taken. For callbacks called several
+    // times, which are taken on their last call. Called from the native side.
+    public static synchronized Object get(long handle, int index) {
+        int slot = (int) handle;
+        int generation = (int) (handle >>> 32);
+
+        if (slot < 0 || slot >= generations.length || generations[slot] != generation) {
+            return null;
+        }
+
+        return objects[slot * SLOT_SIZE + index];
+    }
+
+    // Number of slots in use.
+    public static synchronized int size() {
+        return generations.length - freeCount;
+    }
+
+    private static void grow() {
+        int oldSize = generations.length;
+        int newSize = oldSize * 2;
+
+        objects = Arrays.copyOf(objects, newSize * SLOT_SIZE);
+        generations = Arrays.copyOf(generations, newSize);
+        pending = Arrays.copyOf(pending, newSize);
+        free = Arrays.copyOf(free, newSize);
+
+        release(oldSize, newSize);
+    }
+
+    // Pushes the slots in [begin, end) on the free list, lowest on top.
+    private static void release(int begin, int end) {
+        for (int slot = end - 1; slot >= begin; --slot) {
+            free[freeCount++] = slot;
+        }
+    }
+}
@@ -0,0 +1,5 @@
+// Result of `NativeBindings.getAppInfos`: per app, its error code (0 on
+// success), id, name and key, in the input order.
+public interface Callback_AppInfos {
+    public void call(FfiResult result, int[] codes, int[] ids, String[] names, KeyArray keys);
+}
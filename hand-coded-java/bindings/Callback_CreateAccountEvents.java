@@ -0,0 +1,6 @@
+// Events of a `NativeBindings.createAccount2` session, in order. Events that
+// are pending together come in one call. The last call has the `DISCONNECT`
+// event, or an error and no events.
+public interface Callback_CreateAccountEvents {
+    public void call(FfiResult result, CreateAccountEvent[] events);
+}
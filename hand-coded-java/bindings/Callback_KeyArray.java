@@ -0,0 +1,3 @@
+public interface Callback_KeyArray {
+    public void call(FfiResult result, KeyArray arg);
+}
@@ -0,0 +1,52 @@
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+
+// Destination of `NativeBindings.pollCompletions`. Mirrors the layout of the
+// native `Completion` struct: 64 bytes per record.
+public class CompletionBuffer {
+    public static final int RECORD_SIZE = 64;
+    public static final int PAYLOAD_SIZE = 48;
+
+    public final ByteBuffer buffer;
+    // Number of records filled in by the last poll.
+    public int count;
+
+    public CompletionBuffer(int capacity) {
+        buffer = ByteBuffer.allocateDirect(capacity * RECORD_SIZE)
+                           .order(ByteOrder.nativeOrder());
+    }
+
+    // Drain the native completion queue into this buffer. Returns the number of
+    // records read.
+    public int poll() {
+        count = NativeBindings.pollCompletions(buffer);
+        return count;
+    }
+
+    public long requestId(int index) {
+        return buffer.getLong(index * RECORD_SIZE);
+    }
+
+    public int errorCode(int index) {
+        return buffer.getInt(index * RECORD_SIZE + 8);
+    }
+
+    public int payloadLength(int index) {
+        return buffer.getInt(index * RECORD_SIZE + 12);
+    }
+
+    public int payloadInt(int index) {
+        return buffer.getInt(index * RECORD_SIZE + 16);
+    }
+
+    public Key payloadKey(int index) {
+        Key key = new Key();
+        key.bytes = new byte[Key.SIZE];
+
+        for (int i = 0; i < Key.SIZE; ++i) {
+            key.bytes[i] = buffer.get(index * RECORD_SIZE + 16 + i);
+        }
+
+        return key;
+    }
+}
@@ -0,0 +1,9 @@
+// Event of a `NativeBindings.createAccount2` session.
+public class CreateAccountEvent {
+    public static final int CONNECT = 1;
+    public static final int DISCONNECT = 2;
+
+    public int type;
+    // Set for `CONNECT` events only.
+    public AppInfo appInfo;
+}
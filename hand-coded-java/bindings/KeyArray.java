@@ -0,0 +1,38 @@
+// Array of keys packed into a single byte array, `Key.SIZE` bytes per key. Crosses
+// the native boundary as one array instead of one object per key.
+public class KeyArray {
+    public byte[] bytes;
+
+    public KeyArray(int size) {
+        this.bytes = new byte[size * Key.SIZE];
+    }
+
+    public KeyArray(byte[] bytes) {
+        this.bytes = bytes;
+    }
+
+    public static KeyArray of(Key... keys) {
+        KeyArray output = new KeyArray(keys.length);
+
+        for (int i = 0; i < keys.length; ++i) {
+            output.set(i, keys[i]);
+        }
+
+        return output;
+    }
+
+    public int size() {
+        return bytes.length / Key.SIZE;
+    }
+
+    public Key get(int index) {
+        Key key = new Key();
+        key.bytes = new byte[Key.SIZE];
+        System.arraycopy(bytes, index * Key.SIZE, key.bytes, 0, Key.SIZE);
+        return key;
+    }
+
+    public void set(int index, Key key) {
+        System.arraycopy(key.bytes, 0, bytes, index * Key.SIZE, Key.SIZE);
+    }
+}
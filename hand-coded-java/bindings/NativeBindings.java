@@ -1,22 +1,265 @@
+import java.nio.Buffer;
+import java.nio.ByteBuffer;
+import java.nio.IntBuffer;
 
 public class NativeBindings {
     static {
         System.loadLibrary("frontend");
     }
 
-    public static native void registerApp(AppInfo app, Callback cb);
-    public static native void getAppId(AppInfo app, Callback_int cb);
-    public static native void getAppName(AppInfo app, Callback_String cb);
-    public static native void getAppKey(AppInfo app, Callback_Key cb);
-    public static native void randomNumbers(Callback_array_int cb);
-    public static native void randomKeys(Callback_array_Key cb);
-    public static native void getAppInfo(AppInfo app, Callback_int_String_Key cb);
+    public static native void backendInit(int numThreads);
+    public static native void backendShutdown();
+    // Per-operation call counts and latency histograms of the backend.
+    public static native OpStats[] getStats();
 
-    public static native void createAccount(String locator,
-                                            String password,
-                                            Callback_AppInfo connectCb,
-                                            Callback disconnectCb);
+    // Limits on the calls in flight and the bytes of input they hold (0 means
+    // no limit). Over the limits, a call blocks, fails or is queued depending on
+    // the policy of the calling thread (`AdmissionStats.BLOCK`, ...).
+    public static native void setLimits(long maxRequests, long maxBytes);
+    public static native void setAdmissionPolicy(int policy);
+    public static native AdmissionStats getAdmission();
 
-    public static native void verifySignature(byte[] data, Callback cb);
-    public static native void verifyKeys(Key[] data, Callback cb);
+    // The callbacks are kept in `CallbackRegistry` while the call is in flight.
+    // The natives get the handle of their registry slot as `cb`.
+    public static void registerApp(AppInfo app, Callback cb) {
+        registerApp(app, CallbackRegistry.register(cb));
+    }
+
+    public static void getAppId(AppInfo app, Callback_int cb) {
+        getAppId(app, CallbackRegistry.register(cb));
+    }
+
+    public static void getAppName(AppInfo app, Callback_String cb) {
+        getAppName(app, CallbackRegistry.register(cb));
+    }
+
+    public static void getAppKey(AppInfo app, Callback_Key cb) {
+        getAppKey(app, CallbackRegistry.register(cb));
+    }
+
+    public static void randomNumbers(Callback_array_int cb) {
+        randomNumbers(CallbackRegistry.register(cb));
+    }
+
+    public static void randomKeys(Callback_array_Key cb) {
+        randomKeys(CallbackRegistry.register(cb));
+    }
+
+    public static void randomKeysPacked(Callback_KeyArray cb) {
+        randomKeysPacked(CallbackRegistry.register(cb));
+    }
+
+    public static void getAppInfo(AppInfo app, Callback_int_String_Key cb) {
+        getAppInfo(app, CallbackRegistry.register(cb));
+    }
+
+    public static void createAccount(String locator,
+                                     String password,
+                                     Callback_AppInfo connectCb,
+                                     Callback disconnectCb) {
+        createAccount(locator, password, CallbackRegistry.register(connectCb, disconnectCb));
+    }
+
+    // Single callback variant of `createAccount`: the callback stays registered
+    // for the whole session and gets its events in batches.
+    public static void createAccount2(String locator, String password, Callback_CreateAccountEvents cb) {
+        createAccount2(locator, password, CallbackRegistry.register(cb));
+    }
+
+    // Batch variants: one native call and one callback for all the apps. The
+    // callback gets one error code per app (0 on success).
+    public static void registerApps(AppInfo[] apps, Callback_array_int cb) {
+        registerApps(apps, CallbackRegistry.register(cb));
+    }
+
+    public static void getAppInfos(AppInfo[] apps, Callback_AppInfos cb) {
+        getAppInfos(apps, CallbackRegistry.register(cb));
+    }
+
+    public static void verifySignature(byte[] data, Callback cb) {
+        verifySignature(data, 0, data.length, CallbackRegistry.register(cb));
+    }
+
+    // Verifies the remaining bytes of the buffer. Direct buffers are passed to
+    // the backend without copying, and heap buffers by their backing array, so
+    // neither must be modified until the callback is called. Only read-only
+    // heap buffers, whose array is inaccessible, are copied.
+    public static void verifySignature(ByteBuffer data, Callback cb) {
+        if (data.isDirect()) {
+            // The registry also keeps the buffer reachable during the call.
+            ByteBuffer slice = data.slice();
+            verifySignatureDirect(slice, CallbackRegistry.register(cb, slice));
+        } else if (data.hasArray()) {
+            verifySignature(data.array(),
+                            data.arrayOffset() + data.position(),
+                            data.remaining(),
+                            CallbackRegistry.register(cb));
+        } else {
+            byte[] bytes = new byte[data.remaining()];
+            data.duplicate().get(bytes);
+            verifySignature(bytes, cb);
+        }
+    }
+
+    // Bulk generation, for load tests and key provisioning: fill the output
+    // with pseudo-random numbers or keys, in place, before returning. A given
+    // seed always gives the same values. The buffer variants fill the remaining
+    // elements and consume them. Direct buffers are filled in the native byte
+    // order, so views of a `ByteBuffer` should use `ByteOrder.nativeOrder()`.
+    public static void randomNumbers(long seed, int[] out) {
+        randomNumbersInto(seed, out, 0, out.length);
+    }
+
+    public static void randomNumbers(long seed, IntBuffer out) {
+        if (out.isDirect()) {
+            randomNumbersIntoDirect(seed, out, out.position() * 4, out.remaining());
+        } else {
+            randomNumbersInto(seed, out.array(), out.arrayOffset() + out.position(), out.remaining());
+        }
+
+        out.position(out.limit());
+    }
+
+    public static void randomKeys(long seed, KeyArray out) {
+        randomKeysInto(seed, out.bytes, 0, out.size());
+    }
+
+    public static void randomKeys(long seed, ByteBuffer out) {
+        int count = out.remaining() / Key.SIZE;
+
+        if (out.isDirect()) {
+            randomKeysIntoDirect(seed, out, out.position(), count);
+        } else {
+            randomKeysInto(seed, out.array(), out.arrayOffset() + out.position(), count);
+        }
+
+        out.position(out.position() + count * Key.SIZE);
+    }
+
+    // Offsets are in elements for the arrays, in bytes for the direct buffers.
+    private static native void randomNumbersInto(long seed, int[] out, int offset, int count);
+    private static native void randomNumbersIntoDirect(long seed, Buffer out, int offset, int count);
+    private static native void randomKeysInto(long seed, byte[] out, int offset, int count);
+    private static native void randomKeysIntoDirect(long seed, ByteBuffer out, int offset, int count);
+
+    // Streaming verification, for inputs too large to hold in one array.
+    // `verifySignatureUpdate` scans the chunk before returning, without copying
+    // it, so its buffer can be refilled right away. `verifySignatureFinish`
+    // calls the callback with the result for the whole stream and ends the
+    // session, which then throws `IllegalStateException` if used again.
+    public static VerifySession verifySignatureBegin() {
+        return new VerifySession(newVerifySession());
+    }
+
+    // Scans the remaining bytes of the buffer and consumes them.
+    public static void verifySignatureUpdate(VerifySession session, ByteBuffer chunk) {
+        synchronized (session) {
+            long handle = session.handle();
+
+            if (chunk.isDirect()) {
+                verifySignatureUpdateDirect(handle, chunk, chunk.position(), chunk.remaining());
+            } else if (chunk.hasArray()) {
+                verifySignatureUpdate(handle,
+                                      chunk.array(),
+                                      chunk.arrayOffset() + chunk.position(),
+                                      chunk.remaining());
+            } else {
+                byte[] bytes = new byte[chunk.remaining()];
+                chunk.duplicate().get(bytes);
+                verifySignatureUpdate(handle, bytes, 0, bytes.length);
+            }
+        }
+
+        chunk.position(chunk.limit());
+    }
+
+    public static void verifySignatureUpdate(VerifySession session, byte[] chunk, int offset, int len) {
+        if (offset < 0 || len < 0 || offset > chunk.length - len) {
+            throw new IndexOutOfBoundsException(
+                "offset " + offset + ", length " + len + ", array length " + chunk.length);
+        }
+
+        synchronized (session) {
+            verifySignatureUpdate(session.handle(), chunk, offset, len);
+        }
+    }
+
+    public static void verifySignatureFinish(VerifySession session, Callback cb) {
+        long handle;
+
+        synchronized (session) {
+            handle = session.finish();
+        }
+
+        verifySignatureFinish(handle, CallbackRegistry.register(cb));
+    }
+
+    public static void verifyKeys(Key[] data, Callback cb) {
+        verifyKeys(data, CallbackRegistry.register(cb));
+    }
+
+    public static void verifyKeysPacked(KeyArray data, Callback cb) {
+        verifyKeysPacked(data, CallbackRegistry.register(cb));
+    }
+
+    // The callback gets the indices of the invalid (all zero) keys.
+    public static void findInvalidKeys(Key[] data, Callback_array_int cb) {
+        findInvalidKeys(data, CallbackRegistry.register(cb));
+    }
+
+    public static void findInvalidKeysPacked(KeyArray data, Callback_array_int cb) {
+        findInvalidKeysPacked(data, CallbackRegistry.register(cb));
+    }
+
+    // Verify the content of a file, which the backend maps into memory, so it
+    // never goes through the Java heap. For `verifyKeysFile`, the file holds the
+    // 8-byte keys back to back.
+    public static void verifySignatureFile(String path, Callback cb) {
+        verifySignatureFile(path, CallbackRegistry.register(cb));
+    }
+
+    public static void verifyKeysFile(String path, Callback cb) {
+        verifyKeysFile(path, CallbackRegistry.register(cb));
+    }
+
+    private static native void registerApp(AppInfo app, long cb);
+    private static native void getAppId(AppInfo app, long cb);
+    private static native void getAppName(AppInfo app, long cb);
+    private static native void getAppKey(AppInfo app, long cb);
+    private static native void randomNumbers(long cb);
+    private static native void randomKeys(long cb);
+    private static native void randomKeysPacked(long cb);
+    private static native void getAppInfo(AppInfo app, long cb);
+    private static native void createAccount(String locator, String password, long cbs);
+    private static native void createAccount2(String locator, String password, long cb);
+    private static native void registerApps(AppInfo[] apps, long cb);
+    private static native void getAppInfos(AppInfo[] apps, long cb);
+    private static native void verifySignature(byte[] data, int offset, int len, long cb);
+    private static native void verifySignatureDirect(ByteBuffer data, long cb);
+    private static native long newVerifySession();
+    private static native void verifySignatureUpdate(long session, byte[] chunk, int offset, int len);
+    private static native void verifySignatureUpdateDirect(long session, ByteBuffer chunk, int offset, int len);
+    private static native void verifySignatureFinish(long session, long cb);
+    private static native void verifyKeys(Key[] data, long cb);
+    private static native void verifyKeysPacked(KeyArray data, long cb);
+    private static native void findInvalidKeys(Key[] data, long cb);
+    private static native void findInvalidKeysPacked(KeyArray data, long cb);
+    private static native void verifySignatureFile(String path, long cb);
+    private static native void verifyKeysFile(String path, long cb);
+
+    // Polled completion mode. Instead of calling a callback, the `*Polled`
+    // functions push their result, tagged with `requestId`, into a native
+    // completion queue, which is then drained with `pollCompletions` (see
+    // `CompletionBuffer`). Payloads: none for `registerAppPolled` and
+    // `verifySignaturePolled`, an int for `getAppIdPolled` and a key for
+    // `getAppKeyPolled`. They throw `IllegalStateException` until
+    // `completionQueueInit` has been called.
+    public static native void completionQueueInit(int capacity);
+    // Returns the number of completions written to the (direct) buffer.
+    public static native int pollCompletions(ByteBuffer out);
+
+    public static native void registerAppPolled(AppInfo app, long requestId);
+    public static native void getAppIdPolled(AppInfo app, long requestId);
+    public static native void getAppKeyPolled(AppInfo app, long requestId);
+    public static native void verifySignaturePolled(byte[] data, long requestId);
 }
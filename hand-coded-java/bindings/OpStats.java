@@ -0,0 +1,23 @@
+// Statistics of one backend operation, see `NativeBindings.getStats`.
+public class OpStats {
+    // Phases of a call.
+    public static final int QUEUE   = 0; // from the call to the start of its execution
+    public static final int EXECUTE = 1; // execution on the worker, including the callback
+    public static final int MARSHAL = 2; // conversion of the callback arguments
+    public static final int UPCALL  = 3; // the Java callback itself
+
+    public static final int PHASES  = 4;
+    public static final int BUCKETS = 32;
+
+    public String name;
+    public long count;
+    // Total time spent in each phase, in nanoseconds.
+    public long[] totalNanos;
+    // Latency histograms, `BUCKETS` per phase. Bucket `i` counts the durations
+    // in the [2^i, 2^(i+1)) ns range.
+    public long[] histogram;
+
+    public long histogram(int phase, int bucket) {
+        return histogram[phase * BUCKETS + bucket];
+    }
+}
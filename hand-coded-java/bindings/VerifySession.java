@@ -0,0 +1,25 @@
+// Streaming verification in progress, see `NativeBindings.verifySignatureBegin`.
+// Holds the native session, which is given up when the session is finished, so
+// a finished session can't be used again.
+public class VerifySession {
+    private long handle;
+
+    VerifySession(long handle) {
+        this.handle = handle;
+    }
+
+    long handle() {
+        if (handle == 0) {
+            throw new IllegalStateException("Verify session already finished");
+        }
+
+        return handle;
+    }
+
+    // Returns the native session, which the caller then owns.
+    long finish() {
+        long output = handle();
+        handle = 0;
+        return output;
+    }
+}
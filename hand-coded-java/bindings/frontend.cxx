@@ -1,35 +1,374 @@
 #include <jni.h>
+#include <pthread.h>
 #include <string.h>
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <vector>
 
+#include "arena.h"
 #include "backend.h"
 
 static JavaVM* jvm = nullptr;
+static CompletionQueue* completions = nullptr;
 
 // -----------------------------------------------------------------------------
-// Helpers
+// Signatures
+// -----------------------------------------------------------------------------
+
+// JNI type signature of `N` chars, built at compile time.
+template<size_t N>
+struct Signature {
+    char chars[N + 1];
+};
+
+template<size_t N>
+constexpr Signature<N - 1> signature(const char (&input)[N]) {
+    Signature<N - 1> output {};
+
+    for (size_t i = 0; i < N; ++i) {
+        output.chars[i] = input[i];
+    }
+
+    return output;
+}
+
+template<size_t A, size_t B>
+constexpr Signature<A + B> operator + (const Signature<A>& a, const Signature<B>& b) {
+    Signature<A + B> output {};
+
+    for (size_t i = 0; i < A; ++i) {
+        output.chars[i] = a.chars[i];
+    }
+
+    for (size_t i = 0; i <= B; ++i) {
+        output.chars[A + i] = b.chars[i];
+    }
+
+    return output;
+}
+
+constexpr Signature<0> concat() {
+    return signature("");
+}
+
+template<size_t N, typename... R>
+constexpr auto concat(const Signature<N>& first, const R&... rest) {
+    return first + concat(rest...);
+}
+
+// `java_signature(tag<T>())` is the signature of the Java type `T` converts to.
+// It's overloaded next to each `to_java`, and found by argument-dependent
+// lookup, so it can be used before.
+template<typename T>
+struct tag {};
+
+// Signature of a callback method taking a `FfiResult`, then `T...`.
+template<typename... T>
+constexpr auto method_signature() {
+    return signature("(") + concat(java_signature(tag<T>())...) + signature(")V");
+}
+
+// A Java callback interface, whose `call` method takes a `FfiResult` followed
+// by the conversions of `T...`. The method ID is resolved on first use, with
+// the signature derived from the types, and then kept per instantiation, so
+// each interface must have its own argument types.
+template<typename... T>
+struct CallbackInterface {
+    jclass klass;
+
+    jmethodID call(JNIEnv* env) const {
+        static constexpr auto signature = method_signature<const FfiResult*, T...>();
+        static const jmethodID method = resolve(env, klass, signature.chars);
+
+        return method;
+    }
+
+    static jmethodID resolve(JNIEnv* env, jclass klass, const char* signature) {
+        auto method = env->GetMethodID(klass, "call", signature);
+        assert(method);
+
+        return method;
+    }
+};
+
+// -----------------------------------------------------------------------------
+// Cache
 // -----------------------------------------------------------------------------
 
-jobject new_java_object(JNIEnv* env, jclass klass) {
-    auto constructor = env->GetMethodID(klass, "<init>", "()V");
-    assert(constructor);
+// Converted to Java by the callbacks, defined below.
+struct PackedKeys;
+struct AppInfoIds;
+struct AppInfoNames;
+struct AppInfoKeys;
+
+// Classes (as global refs), method IDs and field IDs used by the conversions
+// and callbacks below. They are resolved once in `JNI_OnLoad` and released in
+// `JNI_OnUnload`. Besides saving the lookups on every call, this is what makes
+// the conversions work on the backend threads: `FindClass` called from a
+// natively attached thread uses the system class loader, which can't see the
+// application classes.
+static struct {
+    struct {
+        jclass klass;
+        jmethodID init;
+        jfieldID errorCode;
+        jfieldID error;
+    } FfiResult;
+
+    struct {
+        jclass klass;
+        jmethodID init;
+        jfieldID bytes;
+    } Key;
+
+    struct {
+        jclass klass;
+        jmethodID init;
+        jfieldID bytes;
+    } KeyArray;
+
+    struct {
+        jclass klass;
+        jmethodID init;
+        jfieldID name;
+        jfieldID count;
+        jfieldID totalNanos;
+        jfieldID histogram;
+    } OpStats;
+
+    struct {
+        jclass klass;
+        jmethodID init;
+        jfieldID id;
+        jfieldID name;
+        jfieldID key;
+    } AppInfo;
+
+    struct {
+        jclass klass;
+        jmethodID init;
+        jfieldID type;
+        jfieldID appInfo;
+    } CreateAccountEvent;
+
+    struct {
+        jclass klass;
+        jmethodID init;
+        jfieldID maxRequests;
+        jfieldID maxBytes;
+        jfieldID requests;
+        jfieldID bytes;
+        jfieldID queued;
+        jfieldID rejected;
+    } AdmissionStats;
+
+    struct {
+        jclass klass;
+    } String;
+
+    struct {
+        jclass klass;
+    } IllegalStateException;
+
+    struct {
+        jclass klass;
+        jmethodID take;
+        jmethodID get;
+    } CallbackRegistry;
+
+    // Callback interfaces, by the types of their arguments. The struct types
+    // are qualified, as the members above hide them.
+    CallbackInterface<> Callback;
+    CallbackInterface<int32_t> Callback_int;
+    CallbackInterface<std::pair<const int32_t*, size_t>> Callback_array_int;
+    CallbackInterface<const char*> Callback_String;
+    CallbackInterface<const ::Key*> Callback_Key;
+    CallbackInterface<std::pair<const ::Key*, size_t>> Callback_array_Key;
+    CallbackInterface<PackedKeys> Callback_KeyArray;
+    CallbackInterface<int32_t, const char*, const ::Key*> Callback_int_String_Key;
+    CallbackInterface<const ::AppInfo*> Callback_AppInfo;
+    CallbackInterface<std::pair<const int32_t*, size_t>,
+                      AppInfoIds,
+                      AppInfoNames,
+                      AppInfoKeys> Callback_AppInfos;
+    CallbackInterface<std::pair<const ::CreateAccountEvent*, size_t>> Callback_CreateAccountEvents;
+} cache;
+
+jclass find_class(JNIEnv* env, const char* name) {
+    auto local = env->FindClass(name);
+    assert(local);
+
+    auto global = (jclass) env->NewGlobalRef(local);
+    env->DeleteLocalRef(local);
+
+    return global;
+}
+
+void cache_init(JNIEnv* env) {
+    cache.FfiResult.klass = find_class(env, "FfiResult");
+    cache.FfiResult.init = env->GetMethodID(cache.FfiResult.klass, "<init>", "()V");
+    cache.FfiResult.errorCode = env->GetFieldID(cache.FfiResult.klass, "errorCode", "I");
+    cache.FfiResult.error = env->GetFieldID(cache.FfiResult.klass, "error", "Ljava/lang/String;");
+    assert(cache.FfiResult.init && cache.FfiResult.errorCode && cache.FfiResult.error);
+
+    cache.Key.klass = find_class(env, "Key");
+    cache.Key.init = env->GetMethodID(cache.Key.klass, "<init>", "()V");
+    cache.Key.bytes = env->GetFieldID(cache.Key.klass, "bytes", "[B");
+    assert(cache.Key.init && cache.Key.bytes);
+
+    cache.KeyArray.klass = find_class(env, "KeyArray");
+    cache.KeyArray.init = env->GetMethodID(cache.KeyArray.klass, "<init>", "([B)V");
+    cache.KeyArray.bytes = env->GetFieldID(cache.KeyArray.klass, "bytes", "[B");
+    assert(cache.KeyArray.init && cache.KeyArray.bytes);
+
+    cache.AppInfo.klass = find_class(env, "AppInfo");
+    cache.AppInfo.init = env->GetMethodID(cache.AppInfo.klass, "<init>", "()V");
+    cache.AppInfo.id = env->GetFieldID(cache.AppInfo.klass, "id", "I");
+    cache.AppInfo.name = env->GetFieldID(cache.AppInfo.klass, "name", "Ljava/lang/String;");
+    cache.AppInfo.key = env->GetFieldID(cache.AppInfo.klass, "key", "LKey;");
+    assert(cache.AppInfo.init && cache.AppInfo.id && cache.AppInfo.name && cache.AppInfo.key);
+
+    cache.CreateAccountEvent.klass = find_class(env, "CreateAccountEvent");
+    cache.CreateAccountEvent.init = env->GetMethodID(cache.CreateAccountEvent.klass, "<init>", "()V");
+    cache.CreateAccountEvent.type = env->GetFieldID(cache.CreateAccountEvent.klass, "type", "I");
+    cache.CreateAccountEvent.appInfo = env->GetFieldID(cache.CreateAccountEvent.klass, "appInfo", "LAppInfo;");
+    assert(cache.CreateAccountEvent.init && cache.CreateAccountEvent.type);
+    assert(cache.CreateAccountEvent.appInfo);
+
+    cache.OpStats.klass = find_class(env, "OpStats");
+    cache.OpStats.init = env->GetMethodID(cache.OpStats.klass, "<init>", "()V");
+    cache.OpStats.name = env->GetFieldID(cache.OpStats.klass, "name", "Ljava/lang/String;");
+    cache.OpStats.count = env->GetFieldID(cache.OpStats.klass, "count", "J");
+    cache.OpStats.totalNanos = env->GetFieldID(cache.OpStats.klass, "totalNanos", "[J");
+    cache.OpStats.histogram = env->GetFieldID(cache.OpStats.klass, "histogram", "[J");
+    assert(cache.OpStats.init && cache.OpStats.name && cache.OpStats.count);
+    assert(cache.OpStats.totalNanos && cache.OpStats.histogram);
+
+    cache.String.klass = find_class(env, "java/lang/String");
+    cache.IllegalStateException.klass = find_class(env, "java/lang/IllegalStateException");
+
+    cache.AdmissionStats.klass = find_class(env, "AdmissionStats");
+    cache.AdmissionStats.init = env->GetMethodID(cache.AdmissionStats.klass, "<init>", "()V");
+    cache.AdmissionStats.maxRequests = env->GetFieldID(cache.AdmissionStats.klass, "maxRequests", "J");
+    cache.AdmissionStats.maxBytes = env->GetFieldID(cache.AdmissionStats.klass, "maxBytes", "J");
+    cache.AdmissionStats.requests = env->GetFieldID(cache.AdmissionStats.klass, "requests", "J");
+    cache.AdmissionStats.bytes = env->GetFieldID(cache.AdmissionStats.klass, "bytes", "J");
+    cache.AdmissionStats.queued = env->GetFieldID(cache.AdmissionStats.klass, "queued", "J");
+    cache.AdmissionStats.rejected = env->GetFieldID(cache.AdmissionStats.klass, "rejected", "J");
+    assert(cache.AdmissionStats.init && cache.AdmissionStats.maxRequests);
+    assert(cache.AdmissionStats.maxBytes && cache.AdmissionStats.requests);
+    assert(cache.AdmissionStats.bytes && cache.AdmissionStats.queued);
+    assert(cache.AdmissionStats.rejected);
+
+    cache.CallbackRegistry.klass = find_class(env, "CallbackRegistry");
+    cache.CallbackRegistry.take = env->GetStaticMethodID(cache.CallbackRegistry.klass,
+                                                         "take",
+                                                         "(JI)Ljava/lang/Object;");
+    cache.CallbackRegistry.get = env->GetStaticMethodID(cache.CallbackRegistry.klass,
+                                                        "get",
+                                                        "(JI)Ljava/lang/Object;");
+    assert(cache.CallbackRegistry.take && cache.CallbackRegistry.get);
+
+    cache.Callback.klass = find_class(env, "Callback");
+    cache.Callback_int.klass = find_class(env, "Callback_int");
+    cache.Callback_array_int.klass = find_class(env, "Callback_array_int");
+    cache.Callback_String.klass = find_class(env, "Callback_String");
+    cache.Callback_Key.klass = find_class(env, "Callback_Key");
+    cache.Callback_array_Key.klass = find_class(env, "Callback_array_Key");
+    cache.Callback_KeyArray.klass = find_class(env, "Callback_KeyArray");
+    cache.Callback_int_String_Key.klass = find_class(env, "Callback_int_String_Key");
+    cache.Callback_AppInfo.klass = find_class(env, "Callback_AppInfo");
+    cache.Callback_AppInfos.klass = find_class(env, "Callback_AppInfos");
+    cache.Callback_CreateAccountEvents.klass = find_class(env, "Callback_CreateAccountEvents");
+}
+
+void cache_release(JNIEnv* env) {
+    jclass classes[] = {
+        cache.FfiResult.klass,
+        cache.Key.klass,
+        cache.KeyArray.klass,
+        cache.AppInfo.klass,
+        cache.CreateAccountEvent.klass,
+        cache.OpStats.klass,
+        cache.String.klass,
+        cache.IllegalStateException.klass,
+        cache.AdmissionStats.klass,
+        cache.CallbackRegistry.klass,
+        cache.Callback.klass,
+        cache.Callback_int.klass,
+        cache.Callback_array_int.klass,
+        cache.Callback_String.klass,
+        cache.Callback_Key.klass,
+        cache.Callback_array_Key.klass,
+        cache.Callback_KeyArray.klass,
+        cache.Callback_int_String_Key.klass,
+        cache.Callback_AppInfo.klass,
+        cache.Callback_AppInfos.klass,
+        cache.Callback_CreateAccountEvents.klass,
+    };
+
+    for (auto klass : classes) {
+        if (klass) {
+            env->DeleteGlobalRef(klass);
+        }
+    }
+
+    memset(&cache, 0, sizeof(cache));
+}
 
+// -----------------------------------------------------------------------------
+// Thread attachment
+// -----------------------------------------------------------------------------
+
+// Holds the `JNIEnv*` of the native threads we attached to the JVM. The thread
+// gets attached on its first callback and detached by the key destructor when
+// it exits.
+static pthread_key_t env_key;
+
+void detach_current_thread(void*) {
+    if (jvm) {
+        jvm->DetachCurrentThread();
+    }
+}
+
+JNIEnv* attach_current_thread() {
+    auto env = (JNIEnv*) pthread_getspecific(env_key);
+    if (env) {
+        return env;
+    }
+
+    // Threads created by the JVM (or attached by someone else) are left alone.
+    if (jvm->GetEnv((void**) &env, JNI_VERSION_1_4) == JNI_OK) {
+        return env;
+    }
+
+    jvm->AttachCurrentThreadAsDaemon((void**) &env, nullptr);
+    assert(env);
+
+    pthread_setspecific(env_key, env);
+    return env;
+}
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+
+jobject new_java_object(JNIEnv* env, jclass klass, jmethodID constructor) {
     auto output = env->NewObject(klass, constructor);
     assert(output);
 
     return output;
 }
 
-template<typename> const char* type_name();
+template<typename> jclass java_class();
 
 // int
 // -----------------------------------------------------------------------------
-template<> const char* type_name<int32_t>() { return "int"; }
+constexpr auto java_signature(tag<int32_t>) { return signature("I"); }
 
 jint to_java(JNIEnv*, int32_t input) {
     return (jint) input;
@@ -37,26 +376,40 @@ jint to_java(JNIEnv*, int32_t input) {
 
 // char*
 // -----------------------------------------------------------------------------
-template<> const char* type_name<const char*>() { return "String"; }
+constexpr auto java_signature(tag<const char*>) { return signature("Ljava/lang/String;"); }
 
 jstring to_java(JNIEnv* env, const char* input) {
     return env->NewStringUTF(input);
 }
 
-void from_java(JNIEnv* env, jstring input, char*& output) {
-    auto chars = env->GetStringUTFChars(input, nullptr);
-    output = strdup(chars);
-    env->ReleaseStringUTFChars(input, chars);
+// The string is copied into `arena`, which the wrappers keep on the stack: it
+// fits in the arena's inline block unless it's long, and is freed with it
+// either way. A null string becomes an empty one.
+void from_java(JNIEnv* env, jstring input, Arena& arena, char*& output) {
+    if (!input) {
+        output = (char*) arena.allocate(1, 1);
+        output[0] = '\0';
+        return;
+    }
+
+    auto len = env->GetStringLength(input);
+    auto size = (size_t) env->GetStringUTFLength(input);
+
+    output = (char*) arena.allocate(size + 1, 1);
+    env->GetStringUTFRegion(input, 0, len, output);
+    output[size] = '\0';
 }
 
 // array of objects / structs
 // -----------------------------------------------------------------------------
 template<typename T>
-jobjectArray to_java(JNIEnv* env, std::pair<const T*, size_t> input) {
-    auto elementClass = env->FindClass(type_name<T>());
-    assert(elementClass);
+constexpr auto java_signature(tag<std::pair<const T*, size_t>>) {
+    return signature("[") + java_signature(tag<const T*>());
+}
 
-    auto array = env->NewObjectArray(input.second, elementClass, 0);
+template<typename T>
+jobjectArray to_java(JNIEnv* env, std::pair<const T*, size_t> input) {
+    auto array = env->NewObjectArray(input.second, java_class<T>(), 0);
     assert(array);
 
     for (auto i = 0; i < input.second; ++i) {
@@ -86,6 +439,8 @@ void from_java(JNIEnv* env, jbyteArray input, std::vector<uint8_t>& output) {
 
 // array of int
 // -----------------------------------------------------------------------------
+constexpr auto java_signature(tag<std::pair<const int32_t*, size_t>>) { return signature("[I"); }
+
 jintArray to_java(JNIEnv* env, std::pair<const int32_t*, size_t> input) {
     auto output = env->NewIntArray(input.second);
     env->SetIntArrayRegion(output, 0, input.second, input.first);
@@ -94,207 +449,445 @@ jintArray to_java(JNIEnv* env, std::pair<const int32_t*, size_t> input) {
 
 // FfiResult
 // -----------------------------------------------------------------------------
-template<> const char* type_name<FfiResult>() { return "FfiResult"; }
+template<> jclass java_class<FfiResult>() { return cache.FfiResult.klass; }
+constexpr auto java_signature(tag<const FfiResult*>) { return signature("LFfiResult;"); }
 
 jobject to_java(JNIEnv* env, const FfiResult* input) {
-    auto klass = env->FindClass("FfiResult");
-    assert(klass);
-
-    auto output = new_java_object(env, klass);
+    auto output = new_java_object(env, cache.FfiResult.klass, cache.FfiResult.init);
 
-    auto f_errorCode = env->GetFieldID(klass, "errorCode", "I");
-    assert(f_errorCode);
-    env->SetIntField(output, f_errorCode, input->error_code);
-
-    auto f_error = env->GetFieldID(klass, "error", "Ljava/lang/String;");
-    assert(f_error);
-    env->SetObjectField(output, f_error, to_java(env, input->error));
+    env->SetIntField(output, cache.FfiResult.errorCode, input->error_code);
+    env->SetObjectField(output, cache.FfiResult.error, to_java(env, input->error));
 
     return output;
 }
 
 // Key
 // -----------------------------------------------------------------------------
-template<> const char* type_name<Key>() { return "Key"; }
+template<> jclass java_class<Key>() { return cache.Key.klass; }
+constexpr auto java_signature(tag<const Key*>) { return signature("LKey;"); }
 
 void from_java(JNIEnv* env, jobject input, Key& output) {
-    auto klass = env->GetObjectClass(input);
-    assert(klass);
-
-    auto f_bytes = env->GetFieldID(klass, "bytes", "[B");
-    assert(f_bytes);
-    auto j_bytes = (jbyteArray) env->GetObjectField(input, f_bytes);
-
+    auto j_bytes = (jbyteArray) env->GetObjectField(input, cache.Key.bytes);
     env->GetByteArrayRegion(j_bytes, 0, 8, (jbyte*) &output.bytes);
+    env->DeleteLocalRef(j_bytes);
 }
 
 jobject to_java(JNIEnv* env, const Key* input) {
-    auto klass = env->FindClass("Key");
-    assert(klass);
-
-    auto output = new_java_object(env, klass);
-
-    auto f_bytes = env->GetFieldID(klass, "bytes", "[B");
-    assert(f_bytes);
+    auto output = new_java_object(env, cache.Key.klass, cache.Key.init);
 
     auto j_bytes = env->NewByteArray(8);
     assert(j_bytes);
 
     env->SetByteArrayRegion(j_bytes, 0, 8, (jbyte*) input->bytes);
-    env->SetObjectField(output, f_bytes, j_bytes);
+    env->SetObjectField(output, cache.Key.bytes, j_bytes);
+
+    return output;
+}
+
+// array of Key, packed (KeyArray)
+// -----------------------------------------------------------------------------
+struct PackedKeys {
+    const Key* ptr;
+    size_t len;
+};
+
+constexpr auto java_signature(tag<PackedKeys>) { return signature("LKeyArray;"); }
+
+jobject to_java(JNIEnv* env, PackedKeys input) {
+    auto size = (jsize) (input.len * sizeof(Key));
+
+    auto j_bytes = env->NewByteArray(size);
+    assert(j_bytes);
+
+    env->SetByteArrayRegion(j_bytes, 0, size, (const jbyte*) input.ptr);
+
+    auto output = env->NewObject(cache.KeyArray.klass, cache.KeyArray.init, j_bytes);
+    assert(output);
+
+    return output;
+}
+
+// OpStats
+// -----------------------------------------------------------------------------
+template<> jclass java_class<OpStats>() { return cache.OpStats.klass; }
+
+jlongArray to_java(JNIEnv* env, const uint64_t* input, size_t len) {
+    auto output = env->NewLongArray(len);
+    env->SetLongArrayRegion(output, 0, len, (const jlong*) input);
+    return output;
+}
+
+jobject to_java(JNIEnv* env, const OpStats* input) {
+    auto output = new_java_object(env, cache.OpStats.klass, cache.OpStats.init);
+
+    env->SetObjectField(output, cache.OpStats.name, to_java(env, input->name));
+    env->SetLongField(output, cache.OpStats.count, (jlong) input->count);
+    env->SetObjectField(output,
+                        cache.OpStats.totalNanos,
+                        to_java(env, input->total_ns, STATS_PHASES));
+    env->SetObjectField(output,
+                        cache.OpStats.histogram,
+                        to_java(env, &input->histogram[0][0], STATS_PHASES * STATS_BUCKETS));
+
+    return output;
+}
+
+// array of AppInfo, packed: one array per field
+// -----------------------------------------------------------------------------
+struct AppInfoIds {
+    const AppInfo* ptr;
+    size_t len;
+};
+
+struct AppInfoNames {
+    const AppInfo* ptr;
+    size_t len;
+};
+
+struct AppInfoKeys {
+    const AppInfo* ptr;
+    size_t len;
+};
+
+constexpr auto java_signature(tag<AppInfoIds>) { return signature("[I"); }
+constexpr auto java_signature(tag<AppInfoNames>) { return signature("[Ljava/lang/String;"); }
+constexpr auto java_signature(tag<AppInfoKeys>) { return signature("LKeyArray;"); }
+
+jintArray to_java(JNIEnv* env, AppInfoIds input) {
+    auto output = env->NewIntArray(input.len);
+    assert(output);
+
+    auto ids = (jint*) env->GetPrimitiveArrayCritical(output, nullptr);
+    for (size_t i = 0; i < input.len; ++i) {
+        ids[i] = input.ptr[i].id;
+    }
+    env->ReleasePrimitiveArrayCritical(output, ids, 0);
+
+    return output;
+}
+
+jobjectArray to_java(JNIEnv* env, AppInfoNames input) {
+    auto output = env->NewObjectArray(input.len, cache.String.klass, nullptr);
+    assert(output);
+
+    for (size_t i = 0; i < input.len; ++i) {
+        auto name = to_java(env, input.ptr[i].name);
+        env->SetObjectArrayElement(output, (jsize) i, name);
+        env->DeleteLocalRef(name);
+    }
+
+    return output;
+}
+
+jobject to_java(JNIEnv* env, AppInfoKeys input) {
+    auto size = (jsize) (input.len * sizeof(Key));
+
+    auto j_bytes = env->NewByteArray(size);
+    assert(j_bytes);
+
+    auto bytes = (Key*) env->GetPrimitiveArrayCritical(j_bytes, nullptr);
+    for (size_t i = 0; i < input.len; ++i) {
+        bytes[i] = input.ptr[i].key;
+    }
+    env->ReleasePrimitiveArrayCritical(j_bytes, bytes, 0);
+
+    auto output = env->NewObject(cache.KeyArray.klass, cache.KeyArray.init, j_bytes);
+    assert(output);
+
+    return output;
+}
+
+// AdmissionStats
+// -----------------------------------------------------------------------------
+jobject to_java(JNIEnv* env, const AdmissionStats* input) {
+    auto output = new_java_object(env, cache.AdmissionStats.klass, cache.AdmissionStats.init);
+
+    env->SetLongField(output, cache.AdmissionStats.maxRequests, (jlong) input->max_requests);
+    env->SetLongField(output, cache.AdmissionStats.maxBytes, (jlong) input->max_bytes);
+    env->SetLongField(output, cache.AdmissionStats.requests, (jlong) input->requests);
+    env->SetLongField(output, cache.AdmissionStats.bytes, (jlong) input->bytes);
+    env->SetLongField(output, cache.AdmissionStats.queued, (jlong) input->queued);
+    env->SetLongField(output, cache.AdmissionStats.rejected, (jlong) input->rejected);
 
     return output;
 }
 
 // AppInfo
 // -----------------------------------------------------------------------------
-void from_java(JNIEnv* env, jobject input, AppInfo& output) {
-    auto klass = env->GetObjectClass(input);
-    assert(klass);
-
-    auto f_id = env->GetFieldID(klass, "id", "I");
-    assert(f_id);
-    output.id = env->GetIntField(input, f_id);
-
-    auto f_name = env->GetFieldID(klass, "name", "Ljava/lang/String;");
-    assert(f_name);
-    auto j_name = (jstring) env->GetObjectField(input, f_name);
-    from_java(env, j_name, output.name);
-
-    auto f_key = env->GetFieldID(klass, "key", "LKey;");
-    assert(f_key);
-    auto j_key = env->GetObjectField(input, f_key);
+template<> jclass java_class<AppInfo>() { return cache.AppInfo.klass; }
+constexpr auto java_signature(tag<const AppInfo*>) { return signature("LAppInfo;"); }
+
+// `output.name` is allocated in `arena`.
+void from_java(JNIEnv* env, jobject input, Arena& arena, AppInfo& output) {
+    output.id = env->GetIntField(input, cache.AppInfo.id);
+
+    auto j_name = (jstring) env->GetObjectField(input, cache.AppInfo.name);
+    from_java(env, j_name, arena, output.name);
+    env->DeleteLocalRef(j_name);
+
+    auto j_key = env->GetObjectField(input, cache.AppInfo.key);
     from_java(env, j_key, output.key);
+    env->DeleteLocalRef(j_key);
+}
+
+// Array of AppInfo in the arena. The elements are released as they're read, so
+// large arrays don't exhaust the local references.
+void from_java(JNIEnv* env, jobjectArray input, Arena& arena, AppInfo*& ptr, size_t& len) {
+    len = (size_t) env->GetArrayLength(input);
+    ptr = (AppInfo*) arena.allocate(len * sizeof(AppInfo), alignof(AppInfo));
+
+    for (size_t i = 0; i < len; ++i) {
+        auto element = env->GetObjectArrayElement(input, (jsize) i);
+        from_java(env, element, arena, ptr[i]);
+        env->DeleteLocalRef(element);
+    }
 }
 
 jobject to_java(JNIEnv* env, const AppInfo* input) {
-    auto klass = env->FindClass("AppInfo");
-    assert(klass);
+    auto output = new_java_object(env, cache.AppInfo.klass, cache.AppInfo.init);
 
-    auto output = new_java_object(env, klass);
+    env->SetIntField(output, cache.AppInfo.id, to_java(env, input->id));
+    env->SetObjectField(output, cache.AppInfo.name, to_java(env, input->name));
+    env->SetObjectField(output, cache.AppInfo.key, to_java(env, &input->key));
+
+    return output;
+}
+
+// CreateAccountEvent
+// -----------------------------------------------------------------------------
+template<> jclass java_class<CreateAccountEvent>() { return cache.CreateAccountEvent.klass; }
+constexpr auto java_signature(tag<const CreateAccountEvent*>) { return signature("LCreateAccountEvent;"); }
 
-    auto f_id = env->GetFieldID(klass, "id", "I");
-    assert(f_id);
-    env->SetIntField(output, f_id, to_java(env, input->id));
+jobject to_java(JNIEnv* env, const CreateAccountEvent* input) {
+    auto output = new_java_object(env, cache.CreateAccountEvent.klass, cache.CreateAccountEvent.init);
 
-    auto f_name = env->GetFieldID(klass, "name", "Ljava/lang/String;");
-    assert(f_name);
-    env->SetObjectField(output, f_name, to_java(env, input->name));
+    env->SetIntField(output, cache.CreateAccountEvent.type, to_java(env, input->type));
 
-    auto f_key = env->GetFieldID(klass, "key", "LKey;");
-    assert(f_key);
-    env->SetObjectField(output, f_key, to_java(env, &input->key));
+    if (input->type == CREATE_ACCOUNT_CONNECT) {
+        env->SetObjectField(output,
+                            cache.CreateAccountEvent.appInfo,
+                            to_java(env, &input->connected.app_info));
+    }
 
     return output;
 }
 
 // -----------------------------------------------------------------------------
 
-template<typename... T>
-void call_impl(const char* cb_class_name, const char* signature, void* ctx, const FfiResult* result, T... args) {
-    JNIEnv* env = nullptr;
-    jvm->AttachCurrentThreadAsDaemon((void**) &env, nullptr);
+// Call the Java callback with the already converted arguments, reporting the
+// time spent converting them (since `started`) and in the callback itself.
+template<typename... J>
+void upcall(JNIEnv* env, jobject cb, jmethodID method, uint64_t started, J... j_args) {
+    auto marshalled = backend_now_ns();
+    backend_record_callback_stat(STATS_MARSHAL, marshalled - started);
 
-    auto cb = (jobject) ctx;
+    env->CallVoidMethod(cb, method, j_args...);
 
-    auto cb_class = env->FindClass(cb_class_name);
-    assert(cb_class);
+    backend_record_callback_stat(STATS_UPCALL, backend_now_ns() - marshalled);
+}
 
-    auto method = env->GetMethodID(cb_class, "call", signature);
-    assert(method);
+// The context of a callback is the `CallbackRegistry` handle of the Java
+// callback objects. Returns null if the handle is stale.
+jobject take_callback(JNIEnv* env, void* ctx, jint index) {
+    return env->CallStaticObjectMethod(cache.CallbackRegistry.klass,
+                                       cache.CallbackRegistry.take,
+                                       (jlong) (uintptr_t) ctx,
+                                       index);
+}
+
+// Like `take_callback`, but leaves the callback registered, for callbacks
+// called several times.
+jobject get_callback(JNIEnv* env, void* ctx, jint index) {
+    return env->CallStaticObjectMethod(cache.CallbackRegistry.klass,
+                                       cache.CallbackRegistry.get,
+                                       (jlong) (uintptr_t) ctx,
+                                       index);
+}
+
+void* to_context(jlong handle) {
+    return (void*) (uintptr_t) handle;
+}
+
+// Call the callback `index` of the context. Functions that take several
+// callbacks register them all under the same handle, in order. The callback is
+// taken out of the registry unless `keep` is set. `args` must have the types
+// the interface was declared with.
+template<typename... T>
+void call_registered(const CallbackInterface<T...>& callback,
+                     jint index,
+                     bool keep,
+                     void* ctx,
+                     const FfiResult* result,
+                     T... args)
+{
+    auto env = attach_current_thread();
+
+    // The backend threads never return to Java, so their local refs have to be
+    // released explicitly.
+    env->PushLocalFrame(16);
+
+    auto started = backend_now_ns();
+    auto cb = keep ? get_callback(env, ctx, index) : take_callback(env, ctx, index);
 
     // TODO: handle exceptions thrown from inside the callback.
 
-    env->CallVoidMethod(cb, method, to_java(env, result), to_java(env, args)...);
-    env->DeleteGlobalRef(cb);
+    if (cb) {
+        upcall(env, cb, callback.call(env), started, to_java(env, result), to_java(env, args)...);
+    }
+
+    env->PopLocalFrame(nullptr);
+}
+
+template<typename... T>
+void call_impl(const CallbackInterface<T...>& callback, jint index, void* ctx, const FfiResult* result, T... args) {
+    call_registered(callback, index, false, ctx, result, args...);
 }
 
 void call(void* ctx, const FfiResult* result) {
-    call_impl("Callback", "(LFfiResult;)V", ctx, result);
+    call_impl(cache.Callback, 0, ctx, result);
 }
 
 void call_int(void* ctx, const FfiResult* result, int32_t arg) {
-    call_impl("Callback_int", "(LFfiResult;I)V", ctx, result, arg);
+    call_impl(cache.Callback_int, 0, ctx, result, arg);
 }
 
 void call_array_int(void* ctx, const FfiResult* result, const int32_t* ptr, size_t len) {
-    call_impl("Callback_array_int",
-              "(LFfiResult;[I)V",
-              ctx,
-              result,
-              std::make_pair(ptr, len));
+    call_impl(cache.Callback_array_int, 0, ctx, result, std::make_pair(ptr, len));
 }
 
 void call_String(void* ctx, const FfiResult* result, const char* arg) {
-    call_impl("Callback_String",
-              "(LFfiResult;Ljava/lang/String;)V",
-              ctx,
-              result,
-              arg);
+    call_impl(cache.Callback_String, 0, ctx, result, arg);
 }
 
 void call_Key(void* ctx, const FfiResult* result, const Key* arg) {
-    call_impl("Callback_Key", "(LFfiResult;LKey;)V", ctx, result, arg);
+    call_impl(cache.Callback_Key, 0, ctx, result, arg);
 }
 
 void call_array_Key(void* ctx, const FfiResult* result, const Key* ptr, size_t len) {
-    call_impl("Callback_array_Key", "(LFfiResult;[LKey;)V", ctx, result, std::make_pair(ptr, len));
+    call_impl(cache.Callback_array_Key, 0, ctx, result, std::make_pair(ptr, len));
+}
+
+void call_KeyArray(void* ctx, const FfiResult* result, const Key* ptr, size_t len) {
+    call_impl(cache.Callback_KeyArray, 0, ctx, result, PackedKeys { ptr, len });
 }
 
 void call_int_String_Key(void* ctx, const FfiResult* result, int32_t arg0, const char* arg1, const Key* arg2) {
-    call_impl("Callback_int_String_Key",
-              "(LFfiResult;ILjava/lang/String;LKey;)V",
+    call_impl(cache.Callback_int_String_Key, 0, ctx, result, arg0, arg1, arg2);
+}
+
+void call_AppInfos(void* ctx,
+                   const FfiResult* result,
+                   const int32_t* codes,
+                   const AppInfo* infos,
+                   size_t len)
+{
+    call_impl(cache.Callback_AppInfos,
+              0,
               ctx,
               result,
-              arg0,
-              arg1,
-              arg2);
+              std::make_pair(codes, len),
+              AppInfoIds { infos, len },
+              AppInfoNames { infos, len },
+              AppInfoKeys { infos, len });
 }
 
-// Helper to call callback of function that take multiple callbacks.
-template<typename... Ts>
-void call_multi_impl(const char* cb_class_name,
-                     const char* signature,
-                     size_t index,
-                     size_t count,
-                     void* ctx,
-                     const FfiResult* result,
-                     Ts... args)
-{
-    JNIEnv* env = nullptr;
-    jvm->AttachCurrentThreadAsDaemon((void**) &env, nullptr);
+void call_createAccount_0(void* ctx, const FfiResult* result, const AppInfo* arg) {
+    call_impl(cache.Callback_AppInfo, 0, ctx, result, arg);
+}
 
-    auto cbs = (jobject*) ctx;
+void call_createAccount_1(void* ctx, const FfiResult* result) {
+    call_impl(cache.Callback, 1, ctx, result);
+}
 
-    auto cb_class = env->FindClass(cb_class_name);
-    assert(cb_class);
+// Called once per batch of events, with the same context for the whole
+// session. The callback is taken on the last call only.
+void call_CreateAccountEvents(void* ctx, const FfiResult* result, const CreateAccountEvent* ptr, size_t len) {
+    auto last = result->error_code != 0 || (len > 0 && ptr[len - 1].type == CREATE_ACCOUNT_DISCONNECT);
+
+    call_registered(cache.Callback_CreateAccountEvents,
+                    0,
+                    !last,
+                    ctx,
+                    result,
+                    std::make_pair(ptr, len));
+}
 
-    auto method = env->GetMethodID(cb_class, "call", signature);
-    assert(method);
+// Context of a call that borrows the elements of a Java byte array for the
+// duration of the call, instead of copying them.
+struct BorrowedBytes {
+    jlong cb;
+    jbyteArray data;
+    jbyte* elements;
+};
 
-    // TODO: handle exceptions thrown from inside the callback.
+void call_borrowed(void* ctx, const FfiResult* result) {
+    auto borrowed = (BorrowedBytes*) ctx;
+    auto cb = to_context(borrowed->cb);
 
-    env->CallVoidMethod(cbs[index], method, to_java(env, result), to_java(env, args)...);
-    env->DeleteGlobalRef(cbs[index]);
-    cbs[index] = nullptr;
+    auto env = attach_current_thread();
 
-    // If all callbacks were already called, we can delete the context to prevent
-    // leaking memory.
-    for (auto i = 0; i < count; ++i) {
-        if (cbs[i] != nullptr) {
-            return;
-        }
-    }
+    env->ReleaseByteArrayElements(borrowed->data, borrowed->elements, JNI_ABORT);
+    env->DeleteGlobalRef(borrowed->data);
+    delete borrowed;
 
-    delete cbs;
+    call(cb, result);
 }
 
-void call_createAccount_0(void* ctx, const FfiResult* result, const AppInfo* arg) {
-    call_multi_impl("Callback_AppInfo", "(LFfiResult;LAppInfo;)V", 0, 2, ctx, result, arg);
+// Like `call`, for a call that borrows a direct buffer. The buffer is the second
+// object in the registry slot; dropping it lets it be collected.
+void call_direct(void* ctx, const FfiResult* result) {
+    auto env = attach_current_thread();
+    env->DeleteLocalRef(take_callback(env, ctx, 1));
+
+    call(ctx, result);
 }
 
-void call_createAccount_1(void* ctx, const FfiResult* result) {
-    call_multi_impl("Callback", "(LFfiResult;)V", 1, 2, ctx, result);
+// Callbacks of the polled completion mode. The context is the request id.
+// -----------------------------------------------------------------------------
+void complete(void* ctx, const FfiResult* result) {
+    completion_queue_push(completions, (uint64_t) (uintptr_t) ctx, result, nullptr, 0);
+}
+
+void complete_int(void* ctx, const FfiResult* result, int32_t arg) {
+    completion_queue_push(completions, (uint64_t) (uintptr_t) ctx, result, &arg, sizeof(arg));
+}
+
+void complete_Key(void* ctx, const FfiResult* result, const Key* arg) {
+    completion_queue_push(completions, (uint64_t) (uintptr_t) ctx, result, arg, sizeof(Key));
+}
+
+// Bulk fills of Java arrays.
+// -----------------------------------------------------------------------------
+// Outputs of at least this many bytes are filled over the pool by the backend,
+// which would keep the GC waiting on a critical region for the whole fill.
+const jint CRITICAL_FILL_MAX = 1 << 20;
+
+// Fill `len` elements of `j_out` from `offset` with `fill(ptr)`. Short outputs
+// are filled in place, in a critical region: the fill makes no JNI calls. Long
+// ones are filled in native memory and copied out with `set(offset, len, ptr)`,
+// one `CRITICAL_FILL_MAX` slice at a time.
+template<typename T, typename F, typename S>
+void fill_array(JNIEnv* env, jarray j_out, jint offset, jint len, F fill, S set) {
+    const jint slice = CRITICAL_FILL_MAX / (jint) sizeof(T);
+
+    if (len < slice) {
+        auto ptr = (T*) env->GetPrimitiveArrayCritical(j_out, nullptr);
+        assert(ptr);
+
+        fill(ptr + offset);
+
+        env->ReleasePrimitiveArrayCritical(j_out, ptr, 0);
+        return;
+    }
+
+    Arena arena;
+    auto ptr = (T*) arena.allocate((size_t) len * sizeof(T), alignof(T));
+
+    fill(ptr);
+
+    for (jint done = 0; done < len; done += slice) {
+        set(offset + done, std::min(len - done, slice), ptr + done);
+    }
 }
 
 // -----------------------------------------------------------------------------
@@ -306,72 +899,194 @@ extern "C" {
 // This is called when `loadLibrary` is called on the Java side.
 jint JNI_OnLoad(JavaVM* vm, void* reserved) {
     jvm = vm;
+
+    JNIEnv* env = nullptr;
+    if (vm->GetEnv((void**) &env, JNI_VERSION_1_4) != JNI_OK) {
+        return JNI_ERR;
+    }
+
+    cache_init(env);
+    pthread_key_create(&env_key, detach_current_thread);
+
     // TODO: not sure about this version.
     return JNI_VERSION_1_4;
 }
 
-void Java_NativeBindings_registerApp(JNIEnv* env, jclass klass, jobject j_app_info, jobject cb) {
+// This is called when the class loader that loaded the library is garbage collected.
+void JNI_OnUnload(JavaVM* vm, void* reserved) {
+    JNIEnv* env = nullptr;
+    if (vm->GetEnv((void**) &env, JNI_VERSION_1_4) != JNI_OK) {
+        return;
+    }
+
+    cache_release(env);
+    pthread_key_delete(env_key);
+
+    if (completions) {
+        completion_queue_free(completions);
+        completions = nullptr;
+    }
+
+    jvm = nullptr;
+}
+
+void Java_NativeBindings_backendInit(JNIEnv* env, jclass klass, jint num_threads) {
+    backend_init((size_t) num_threads);
+}
+
+void Java_NativeBindings_backendShutdown(JNIEnv* env, jclass klass) {
+    backend_shutdown();
+}
+
+jobjectArray Java_NativeBindings_getStats(JNIEnv* env, jclass klass) {
+    std::vector<OpStats> stats(64);
+    stats.resize(backend_get_stats(stats.data(), stats.size()));
+
+    return to_java(env, std::make_pair((const OpStats*) stats.data(), stats.size()));
+}
+
+void Java_NativeBindings_setLimits(JNIEnv* env, jclass klass, jlong max_requests, jlong max_bytes) {
+    backend_set_limits((size_t) max_requests, (size_t) max_bytes);
+}
+
+void Java_NativeBindings_setAdmissionPolicy(JNIEnv* env, jclass klass, jint policy) {
+    backend_set_admission_policy((AdmissionPolicy) policy);
+}
+
+jobject Java_NativeBindings_getAdmission(JNIEnv* env, jclass klass) {
+    AdmissionStats stats;
+    backend_get_admission(&stats);
+
+    return to_java(env, &stats);
+}
+
+void Java_NativeBindings_registerApp(JNIEnv* env, jclass klass, jobject j_app_info, jlong cb) {
+    Arena arena;
     AppInfo app_info;
-    from_java(env, j_app_info, app_info);
+    from_java(env, j_app_info, arena, app_info);
 
-    auto ctx = (void*) env->NewGlobalRef(cb);
-    env->DeleteLocalRef(cb);
+    auto ctx = to_context(cb);
 
     register_app(&app_info, ctx, call);
-
-    // TODO: clean up app_info.
 }
 
-void Java_NativeBindings_getAppId(JNIEnv* env, jclass klass, jobject j_app_info, jobject cb) {
+void Java_NativeBindings_getAppId(JNIEnv* env, jclass klass, jobject j_app_info, jlong cb) {
+    Arena arena;
     AppInfo app_info;
-    from_java(env, j_app_info, app_info);
+    from_java(env, j_app_info, arena, app_info);
 
-    auto ctx = (void*) env->NewGlobalRef(cb);
-    env->DeleteLocalRef(cb);
+    auto ctx = to_context(cb);
 
     get_app_id(&app_info, ctx, call_int);
 }
 
-void Java_NativeBindings_getAppName(JNIEnv* env, jclass klass, jobject j_app_info, jobject cb) {
+void Java_NativeBindings_getAppName(JNIEnv* env, jclass klass, jobject j_app_info, jlong cb) {
+    Arena arena;
     AppInfo app_info;
-    from_java(env, j_app_info, app_info);
+    from_java(env, j_app_info, arena, app_info);
 
-    auto ctx = (void*) env->NewGlobalRef(cb);
-    env->DeleteLocalRef(cb);
+    auto ctx = to_context(cb);
 
     get_app_name(&app_info, ctx, call_String);
 }
 
-void Java_NativeBindings_getAppKey(JNIEnv* env, jclass klass, jobject j_app_info, jobject cb) {
+void Java_NativeBindings_getAppKey(JNIEnv* env, jclass klass, jobject j_app_info, jlong cb) {
+    Arena arena;
     AppInfo app_info;
-    from_java(env, j_app_info, app_info);
+    from_java(env, j_app_info, arena, app_info);
 
-    auto ctx = (void*) env->NewGlobalRef(cb);
-    env->DeleteLocalRef(cb);
+    auto ctx = to_context(cb);
 
     get_app_key(&app_info, ctx, call_Key);
 }
 
-void Java_NativeBindings_randomNumbers(JNIEnv* env, jclass klass, jobject cb) {
-    auto ctx = (void*) env->NewGlobalRef(cb);
-    env->DeleteLocalRef(cb);
+void Java_NativeBindings_randomNumbers(JNIEnv* env, jclass klass, jlong cb) {
+    auto ctx = to_context(cb);
 
     random_numbers(ctx, call_array_int);
 }
 
-void Java_NativeBindings_randomKeys(JNIEnv* env, jclass klass, jobject cb) {
-    auto ctx = (void*) env->NewGlobalRef(cb);
-    env->DeleteLocalRef(cb);
+void Java_NativeBindings_randomKeys(JNIEnv* env, jclass klass, jlong cb) {
+    auto ctx = to_context(cb);
 
     random_keys(ctx, call_array_Key);
 }
 
-void Java_NativeBindings_getAppInfo(JNIEnv* env, jclass klass, jobject j_app_info, jobject cb) {
+void Java_NativeBindings_randomKeysPacked(JNIEnv* env, jclass klass, jlong cb) {
+    auto ctx = to_context(cb);
+
+    random_keys(ctx, call_KeyArray);
+}
+
+void Java_NativeBindings_randomNumbersInto(JNIEnv* env,
+                                           jclass klass,
+                                           jlong seed,
+                                           jintArray j_out,
+                                           jint offset,
+                                           jint count)
+{
+    auto fill = [=](jint* ptr) {
+        random_numbers_fill((uint64_t) seed, (int32_t*) ptr, (size_t) count);
+    };
+
+    auto set = [=](jint start, jint len, const jint* ptr) {
+        env->SetIntArrayRegion(j_out, start, len, ptr);
+    };
+
+    fill_array<jint>(env, j_out, offset, count, fill, set);
+}
+
+void Java_NativeBindings_randomNumbersIntoDirect(JNIEnv* env,
+                                                 jclass klass,
+                                                 jlong seed,
+                                                 jobject j_out,
+                                                 jint offset,
+                                                 jint count)
+{
+    auto ptr = (uint8_t*) env->GetDirectBufferAddress(j_out);
+    assert(ptr);
+
+    random_numbers_fill((uint64_t) seed, (int32_t*) (ptr + offset), (size_t) count);
+}
+
+// `offset` is in bytes, `count` in keys.
+void Java_NativeBindings_randomKeysInto(JNIEnv* env,
+                                        jclass klass,
+                                        jlong seed,
+                                        jbyteArray j_out,
+                                        jint offset,
+                                        jint count)
+{
+    auto fill = [=](jbyte* ptr) {
+        random_keys_fill((uint64_t) seed, (Key*) ptr, (size_t) count);
+    };
+
+    auto set = [=](jint start, jint len, const jbyte* ptr) {
+        env->SetByteArrayRegion(j_out, start, len, ptr);
+    };
+
+    fill_array<jbyte>(env, j_out, offset, count * (jint) sizeof(Key), fill, set);
+}
+
+void Java_NativeBindings_randomKeysIntoDirect(JNIEnv* env,
+                                              jclass klass,
+                                              jlong seed,
+                                              jobject j_out,
+                                              jint offset,
+                                              jint count)
+{
+    auto ptr = (uint8_t*) env->GetDirectBufferAddress(j_out);
+    assert(ptr);
+
+    random_keys_fill((uint64_t) seed, (Key*) (ptr + offset), (size_t) count);
+}
+
+void Java_NativeBindings_getAppInfo(JNIEnv* env, jclass klass, jobject j_app_info, jlong cb) {
+    Arena arena;
     AppInfo app_info;
-    from_java(env, j_app_info, app_info);
+    from_java(env, j_app_info, arena, app_info);
 
-    auto ctx = (void*) env->NewGlobalRef(cb);
-    env->DeleteLocalRef(cb);
+    auto ctx = to_context(cb);
 
     get_app_info(&app_info, ctx, call_int_String_Key);
 }
@@ -380,53 +1095,287 @@ void Java_NativeBindings_createAccount(JNIEnv* env,
                                        jclass klass,
                                        jstring j_locator,
                                        jstring j_password,
-                                       jobject connect_cb,
-                                       jobject disconnect_cb)
+                                       jlong cbs)
 {
+    Arena arena;
+
     char* locator;
-    from_java(env, j_locator, locator);
+    from_java(env, j_locator, arena, locator);
 
     char* password;
-    from_java(env, j_password, password);
-
-    auto cbs = new jobject[2];
-    cbs[0] = env->NewGlobalRef(connect_cb);
-    cbs[1] = env->NewGlobalRef(disconnect_cb);
-
-    env->DeleteLocalRef(connect_cb);
-    env->DeleteLocalRef(disconnect_cb);
+    from_java(env, j_password, arena, password);
 
     create_account(locator,
                    password,
-                   (void*) cbs,
+                   to_context(cbs),
                    call_createAccount_0,
                    call_createAccount_1);
+}
+
+void Java_NativeBindings_createAccount2(JNIEnv* env,
+                                        jclass klass,
+                                        jstring j_locator,
+                                        jstring j_password,
+                                        jlong cb)
+{
+    Arena arena;
+
+    char* locator;
+    from_java(env, j_locator, arena, locator);
+
+    char* password;
+    from_java(env, j_password, arena, password);
 
-    free(locator);
-    free(password);
+    create_account_2(locator, password, to_context(cb), call_CreateAccountEvents);
 }
 
-void Java_NativeBindings_verifySignature(JNIEnv* env, jclass klass, jbyteArray j_data, jobject cb) {
-    // TODO: instead of copying the data from the java array, we can "borrow" it
-    // and then release it at the end - potentially avoiding the copy.
+void Java_NativeBindings_registerApps(JNIEnv* env, jclass klass, jobjectArray j_apps, jlong cb) {
+    Arena arena;
+    AppInfo* apps;
+    size_t len;
+    from_java(env, j_apps, arena, apps, len);
 
-    std::vector<uint8_t> data;
-    from_java(env, j_data, data);
+    register_apps(apps, len, to_context(cb), call_array_int);
+}
+
+void Java_NativeBindings_getAppInfos(JNIEnv* env, jclass klass, jobjectArray j_apps, jlong cb) {
+    Arena arena;
+    AppInfo* apps;
+    size_t len;
+    from_java(env, j_apps, arena, apps, len);
+
+    get_app_infos(apps, len, to_context(cb), call_AppInfos);
+}
+
+void Java_NativeBindings_verifySignature(JNIEnv* env,
+                                         jclass klass,
+                                         jbyteArray j_data,
+                                         jint offset,
+                                         jint len,
+                                         jlong cb)
+{
+    // Borrow the array elements for the duration of the call. The JVM pins the
+    // array if it can, otherwise it hands us a single copy.
+    auto borrowed = new BorrowedBytes;
+    borrowed->cb = cb;
+    borrowed->data = (jbyteArray) env->NewGlobalRef(j_data);
+    borrowed->elements = env->GetByteArrayElements(j_data, nullptr);
+    assert(borrowed->elements);
+
+    auto ptr = (const uint8_t*) borrowed->elements + offset;
+
+    verify_signature_borrowed(ptr, (size_t) len, borrowed, call_borrowed);
+}
+
+// The registry slot of `cb` also holds the buffer, which keeps it reachable until
+// the call completes.
+void Java_NativeBindings_verifySignatureDirect(JNIEnv* env, jclass klass, jobject j_data, jlong cb) {
+    auto ptr = (const uint8_t*) env->GetDirectBufferAddress(j_data);
+    assert(ptr);
 
-    auto ctx = (void*) env->NewGlobalRef(cb);
-    env->DeleteLocalRef(cb);
+    auto len = (size_t) env->GetDirectBufferCapacity(j_data);
+
+    verify_signature_borrowed(ptr, len, to_context(cb), call_direct);
+}
+
+jlong Java_NativeBindings_newVerifySession(JNIEnv* env, jclass klass) {
+    return (jlong) (uintptr_t) verify_signature_begin();
+}
+
+// Longest slice of a `byte[]` chunk scanned in one critical region.
+const jint CRITICAL_SCAN_MAX = 1 << 20;
+
+void Java_NativeBindings_verifySignatureUpdate(JNIEnv* env,
+                                               jclass klass,
+                                               jlong session,
+                                               jbyteArray j_chunk,
+                                               jint offset,
+                                               jint len)
+{
+    // Each slice is scanned before `verify_signature_update` returns, without
+    // any JNI calls, so the array can be held in a critical region. The slices
+    // are short enough to be scanned on this thread rather than over the pool,
+    // which keeps the GC waiting for one slice at a time. `offset` and `len` are
+    // checked by the Java side.
+    for (jint done = 0; done < len; done += CRITICAL_SCAN_MAX) {
+        auto slice = std::min(len - done, CRITICAL_SCAN_MAX);
+
+        auto ptr = (const uint8_t*) env->GetPrimitiveArrayCritical(j_chunk, nullptr);
+        assert(ptr);
+
+        verify_signature_update((VerifySession*) (uintptr_t) session,
+                                ptr + offset + done,
+                                (size_t) slice);
+
+        env->ReleasePrimitiveArrayCritical(j_chunk, (void*) ptr, JNI_ABORT);
+    }
+}
+
+void Java_NativeBindings_verifySignatureUpdateDirect(JNIEnv* env,
+                                                     jclass klass,
+                                                     jlong session,
+                                                     jobject j_chunk,
+                                                     jint offset,
+                                                     jint len)
+{
+    auto ptr = (const uint8_t*) env->GetDirectBufferAddress(j_chunk);
+    assert(ptr);
 
-    verify_signature(&data[0], data.size(), ctx, call);
+    verify_signature_update((VerifySession*) (uintptr_t) session, ptr + offset, (size_t) len);
 }
 
-void Java_NativeBindings_verifyKeys(JNIEnv* env, jclass klass, jobjectArray j_data, jobject cb) {
+void Java_NativeBindings_verifySignatureFinish(JNIEnv* env, jclass klass, jlong session, jlong cb) {
+    verify_signature_finish((VerifySession*) (uintptr_t) session, to_context(cb), call);
+}
+
+void Java_NativeBindings_verifyKeys(JNIEnv* env, jclass klass, jobjectArray j_data, jlong cb) {
     std::vector<Key> data;
     from_java(env, j_data, data);
 
-    auto ctx = (void*) env->NewGlobalRef(cb);
-    env->DeleteLocalRef(cb);
+    auto ctx = to_context(cb);
 
     verify_keys(&data[0], data.size(), ctx, call);
 }
 
+void Java_NativeBindings_verifyKeysPacked(JNIEnv* env, jclass klass, jobject j_data, jlong cb) {
+    auto j_bytes = (jbyteArray) env->GetObjectField(j_data, cache.KeyArray.bytes);
+    auto len = (size_t) env->GetArrayLength(j_bytes) / sizeof(Key);
+
+    auto ctx = to_context(cb);
+
+    // Copied out with a single JNI call rather than held in a critical region:
+    // admission control can run the callback, or block, before `verify_keys`
+    // returns, and neither is allowed inside one.
+    Arena arena;
+    auto ptr = (Key*) arena.allocate(len * sizeof(Key), alignof(Key));
+    env->GetByteArrayRegion(j_bytes, 0, (jsize) (len * sizeof(Key)), (jbyte*) ptr);
+
+    verify_keys(ptr, len, ctx, call);
+}
+
+void Java_NativeBindings_findInvalidKeys(JNIEnv* env, jclass klass, jobjectArray j_data, jlong cb) {
+    std::vector<Key> data;
+    from_java(env, j_data, data);
+
+    auto ctx = to_context(cb);
+
+    find_invalid_keys(data.data(), data.size(), ctx, call_array_int);
+}
+
+void Java_NativeBindings_findInvalidKeysPacked(JNIEnv* env, jclass klass, jobject j_data, jlong cb) {
+    auto j_bytes = (jbyteArray) env->GetObjectField(j_data, cache.KeyArray.bytes);
+    auto len = (size_t) env->GetArrayLength(j_bytes) / sizeof(Key);
+
+    auto ctx = to_context(cb);
+
+    // Copied out, as for `verify_keys`.
+    Arena arena;
+    auto ptr = (Key*) arena.allocate(len * sizeof(Key), alignof(Key));
+    env->GetByteArrayRegion(j_bytes, 0, (jsize) (len * sizeof(Key)), (jbyte*) ptr);
+
+    find_invalid_keys(ptr, len, ctx, call_array_int);
+}
+
+void Java_NativeBindings_verifySignatureFile(JNIEnv* env, jclass klass, jstring j_path, jlong cb) {
+    Arena arena;
+
+    char* path;
+    from_java(env, j_path, arena, path);
+
+    verify_signature_file(path, to_context(cb), call);
+}
+
+void Java_NativeBindings_verifyKeysFile(JNIEnv* env, jclass klass, jstring j_path, jlong cb) {
+    Arena arena;
+
+    char* path;
+    from_java(env, j_path, arena, path);
+
+    verify_keys_file(path, to_context(cb), call);
+}
+
+void Java_NativeBindings_completionQueueInit(JNIEnv* env, jclass klass, jint capacity) {
+    if (!completions) {
+        completions = completion_queue_new((size_t) capacity);
+    }
+}
+
+jint Java_NativeBindings_pollCompletions(JNIEnv* env, jclass klass, jobject j_out) {
+    if (!completions) {
+        return 0;
+    }
+
+    auto out = (Completion*) env->GetDirectBufferAddress(j_out);
+    assert(out);
+
+    auto max = (size_t) env->GetDirectBufferCapacity(j_out) / sizeof(Completion);
+
+    return (jint) completion_queue_poll(completions, out, max);
+}
+
+// The polled calls push their results into `completions`, so the queue must
+// exist before any of them is issued. Throws otherwise.
+bool check_completions(JNIEnv* env) {
+    if (!completions) {
+        env->ThrowNew(cache.IllegalStateException.klass, "completionQueueInit was not called");
+        return false;
+    }
+
+    return true;
+}
+
+void Java_NativeBindings_registerAppPolled(JNIEnv* env, jclass klass, jobject j_app_info, jlong request_id) {
+    if (!check_completions(env)) {
+        return;
+    }
+
+    Arena arena;
+    AppInfo app_info;
+    from_java(env, j_app_info, arena, app_info);
+
+    register_app(&app_info, (void*) (uintptr_t) request_id, complete);
+}
+
+void Java_NativeBindings_getAppIdPolled(JNIEnv* env, jclass klass, jobject j_app_info, jlong request_id) {
+    if (!check_completions(env)) {
+        return;
+    }
+
+    Arena arena;
+    AppInfo app_info;
+    from_java(env, j_app_info, arena, app_info);
+
+    get_app_id(&app_info, (void*) (uintptr_t) request_id, complete_int);
+}
+
+void Java_NativeBindings_getAppKeyPolled(JNIEnv* env, jclass klass, jobject j_app_info, jlong request_id) {
+    if (!check_completions(env)) {
+        return;
+    }
+
+    Arena arena;
+    AppInfo app_info;
+    from_java(env, j_app_info, arena, app_info);
+
+    get_app_key(&app_info, (void*) (uintptr_t) request_id, complete_Key);
+}
+
+void Java_NativeBindings_verifySignaturePolled(JNIEnv* env, jclass klass, jbyteArray j_data, jlong request_id) {
+    if (!check_completions(env)) {
+        return;
+    }
+
+    // `verify_signature` copies the input into the request's arena, so the
+    // elements are only needed for the duration of the call. The JVM pins the
+    // array if it can, leaving that as the only copy.
+    auto elements = env->GetByteArrayElements(j_data, nullptr);
+    assert(elements);
+
+    auto len = (size_t) env->GetArrayLength(j_data);
+
+    verify_signature((const uint8_t*) elements, len, (void*) (uintptr_t) request_id, complete);
+
+    env->ReleaseByteArrayElements(j_data, elements, JNI_ABORT);
+}
+
 } // extern "C"
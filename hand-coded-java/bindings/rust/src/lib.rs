@@ -4,16 +4,16 @@ extern crate jni;
 
 // Extensions for the JNI crate.
 mod jni_ext;
-#[macro_use]
-mod macros;
 
 use jni::JNIEnv;
-use jni::objects::{GlobalRef, JClass, JObject, JString};
+use jni::objects::{JByteBuffer, JClass, JObject, JString, JValue};
 use jni::strings::JNIStr;
-use jni_ext::{GlobalRefExt, JAVA_VM_INIT, JavaVM};
+use jni_ext::{JAVA_VM_INIT, JavaVM};
+use std::cmp;
 use std::ffi::{CStr, CString};
 use std::mem;
 use std::os::raw::{c_char, c_void};
+use std::ptr;
 use std::slice;
 
 mod backend {
@@ -86,6 +86,17 @@ impl<'a, 'b> ToJava<'a, JObject<'a>> for &'b [i32] {
     }
 }
 
+// Java has no unsigned types, so the counters are passed as `long` values.
+impl<'a, 'b> ToJava<'a, JObject<'a>> for &'b [u64] {
+    fn to_java(&self, env: &'a JNIEnv) -> JObject<'a> {
+        let output = env.new_long_array(self.len() as jni::sys::jsize).unwrap();
+        let values =
+            unsafe { slice::from_raw_parts(self.as_ptr() as *const i64, self.len()) };
+        env.set_long_array_region(output, 0, values).unwrap();
+        JObject::from(output as jni::sys::jobject)
+    }
+}
+
 // TODO: this would have to be explicitly implemented for array of all types and
 // sizes we need. Consider using macro.
 impl<'a> FromJava<JObject<'a>> for [i8; 8] {
@@ -142,6 +153,120 @@ impl<'a> ToJava<'a, JObject<'a>> for backend::FfiResult {
     }
 }
 
+impl<'a> FromJava<JObject<'a>> for Vec<backend::AppInfo> {
+    fn from_java(env: &JNIEnv, input: JObject) -> Self {
+        let input = input.into_inner() as jni::sys::jobjectArray;
+        let len = env.get_array_length(input).unwrap() as usize;
+
+        let mut output = Vec::with_capacity(len);
+
+        for index in 0..len {
+            let item = env.get_object_array_element(input, index as jni::sys::jsize)
+                .unwrap();
+            output.push(backend::AppInfo::from_java(&env, item));
+            env.delete_local_ref(item).unwrap();
+        }
+
+        output
+    }
+}
+
+// Array of apps converted to one Java array per field: ids, names and keys
+// (packed into a `KeyArray`).
+struct PackedAppInfos<'b>(&'b [backend::AppInfo]);
+
+impl<'a, 'b> PackedAppInfos<'b> {
+    fn ids(&self, env: &'a JNIEnv) -> JObject<'a> {
+        let ids: Vec<i32> = self.0.iter().map(|info| info.id).collect();
+        ids.as_slice().to_java(env)
+    }
+
+    fn names(&self, env: &'a JNIEnv) -> JObject<'a> {
+        let output = env.new_object_array(
+            self.0.len() as jni::sys::jsize,
+            "java/lang/String",
+            JObject::null(),
+        ).unwrap();
+
+        for (index, info) in self.0.iter().enumerate() {
+            let name: JObject = info.name.to_java(env).into();
+            env.set_object_array_element(output, index as jni::sys::jsize, name)
+                .unwrap();
+            env.delete_local_ref(name).unwrap();
+        }
+
+        JObject::from(output as jni::sys::jobject)
+    }
+
+    fn keys(&self, env: &'a JNIEnv) -> JObject<'a> {
+        let keys: Vec<backend::Key> = self.0.iter().map(|info| info.key).collect();
+        PackedKeys(&keys).to_java(env)
+    }
+}
+
+impl<'a> ToJava<'a, JObject<'a>> for backend::AdmissionStats {
+    fn to_java(&self, env: &'a JNIEnv) -> JObject<'a> {
+        let output = env.new_object("AdmissionStats", "()V", &[]).unwrap();
+
+        let fields = [
+            ("maxRequests", self.max_requests),
+            ("maxBytes", self.max_bytes),
+            ("requests", self.requests),
+            ("bytes", self.bytes),
+            ("queued", self.queued),
+            ("rejected", self.rejected),
+        ];
+
+        for &(name, value) in fields.iter() {
+            env.set_field(output, name, "J", JValue::Long(value as i64))
+                .unwrap();
+        }
+
+        output
+    }
+}
+
+impl<'a> ToJava<'a, JObject<'a>> for backend::OpStats {
+    fn to_java(&self, env: &'a JNIEnv) -> JObject<'a> {
+        let output = env.new_object("OpStats", "()V", &[]).unwrap();
+
+        let name: JObject = self.name.to_java(env).into();
+        env.set_field(output, "name", "Ljava/lang/String;", name.into())
+            .unwrap();
+        env.set_field(output, "count", "J", JValue::Long(self.count as i64))
+            .unwrap();
+
+        let total_nanos = (&self.total_ns[..]).to_java(env);
+        env.set_field(output, "totalNanos", "[J", total_nanos.into())
+            .unwrap();
+
+        // Flattened phase-major, like `OpStats.histogram` expects.
+        let histogram: Vec<u64> = self.histogram.iter().flat_map(|phase| phase.iter().cloned())
+            .collect();
+        let histogram = histogram.as_slice().to_java(env);
+        env.set_field(output, "histogram", "[J", histogram.into())
+            .unwrap();
+
+        output
+    }
+}
+
+impl<'a, 'b> ToJava<'a, JObject<'a>> for &'b [backend::OpStats] {
+    fn to_java(&self, env: &'a JNIEnv) -> JObject<'a> {
+        let output = env.new_object_array(self.len() as jni::sys::jsize, "OpStats", JObject::null())
+            .unwrap();
+
+        for (index, item) in self.iter().enumerate() {
+            let item = item.to_java(env);
+            env.set_object_array_element(output, index as jni::sys::jsize, item)
+                .unwrap();
+            env.delete_local_ref(item).unwrap();
+        }
+
+        JObject::from(output as jni::sys::jobject)
+    }
+}
+
 impl<'a> FromJava<JObject<'a>> for backend::Key {
     fn from_java(env: &JNIEnv, input: JObject) -> Self {
         let bytes = env.get_field(input, "bytes", "[B").unwrap().l().unwrap();
@@ -193,6 +318,29 @@ impl<'a> FromJava<JObject<'a>> for Vec<backend::Key> {
     }
 }
 
+// Array of keys packed into a single `KeyArray` byte array.
+struct PackedKeys<'b>(&'b [backend::Key]);
+
+impl<'a, 'b> ToJava<'a, JObject<'a>> for PackedKeys<'b> {
+    fn to_java(&self, env: &'a JNIEnv) -> JObject<'a> {
+        let bytes = unsafe {
+            slice::from_raw_parts(
+                self.0.as_ptr() as *const i8,
+                self.0.len() * mem::size_of::<backend::Key>(),
+            )
+        };
+
+        let array = env.new_byte_array(bytes.len() as jni::sys::jsize).unwrap();
+        env.set_byte_array_region(array, 0, bytes).unwrap();
+
+        env.new_object(
+            "KeyArray",
+            "([B)V",
+            &[JObject::from(array as jni::sys::jobject).into()],
+        ).unwrap()
+    }
+}
+
 impl<'a> FromJava<JObject<'a>> for backend::AppInfo {
     fn from_java(env: &JNIEnv, input: JObject) -> Self {
         let id = env.get_field(input, "id", "I").unwrap().i().unwrap() as i32;
@@ -233,25 +381,107 @@ impl<'a> ToJava<'a, JObject<'a>> for backend::AppInfo {
     }
 }
 
+impl<'a> ToJava<'a, JObject<'a>> for backend::CreateAccountEvent {
+    fn to_java(&self, env: &'a JNIEnv) -> JObject<'a> {
+        let output = env.new_object("CreateAccountEvent", "()V", &[]).unwrap();
+
+        env.set_field(output, "type", "I", self.type_.to_java(env).into())
+            .unwrap();
+
+        if self.type_ == backend::CREATE_ACCOUNT_CONNECT as i32 {
+            let app_info = unsafe { self.__bindgen_anon_1.connected.app_info.to_java(env) };
+            env.set_field(output, "appInfo", "LAppInfo;", app_info.into())
+                .unwrap();
+        }
+
+        output
+    }
+}
+
+impl<'a, 'b> ToJava<'a, JObject<'a>> for &'b [backend::CreateAccountEvent] {
+    fn to_java(&self, env: &'a JNIEnv) -> JObject<'a> {
+        let output = env.new_object_array(
+            self.len() as jni::sys::jsize,
+            "CreateAccountEvent",
+            JObject::null(),
+        ).unwrap();
+
+        for (index, item) in self.iter().enumerate() {
+            env.set_object_array_element(output, index as jni::sys::jsize, item.to_java(env))
+                .unwrap();
+        }
+
+        JObject::from(output as jni::sys::jobject)
+    }
+}
+
+// The context of a callback is the `CallbackRegistry` handle of the Java
+// callback objects. Returns `None` if the handle is stale.
+unsafe fn take_callback<'a>(env: &'a JNIEnv, ctx: *mut c_void, index: i32) -> Option<JObject<'a>> {
+    let cb = env.call_static_method(
+        "CallbackRegistry",
+        "take",
+        "(JI)Ljava/lang/Object;",
+        &[JValue::Long(ctx as i64), JValue::Int(index)],
+    ).unwrap()
+        .l()
+        .unwrap();
+
+    if cb.into_inner().is_null() {
+        None
+    } else {
+        Some(cb)
+    }
+}
+
+// Like `take_callback`, but leaves the callback registered, for callbacks
+// called several times.
+unsafe fn get_callback<'a>(env: &'a JNIEnv, ctx: *mut c_void, index: i32) -> Option<JObject<'a>> {
+    let cb = env.call_static_method(
+        "CallbackRegistry",
+        "get",
+        "(JI)Ljava/lang/Object;",
+        &[JValue::Long(ctx as i64), JValue::Int(index)],
+    ).unwrap()
+        .l()
+        .unwrap();
+
+    if cb.into_inner().is_null() {
+        None
+    } else {
+        Some(cb)
+    }
+}
+
+fn to_context(handle: jni::sys::jlong) -> *mut c_void {
+    handle as usize as *mut c_void
+}
+
 unsafe extern "C" fn call(ctx: *mut c_void, result: *const backend::FfiResult) {
     let env = JVM.attach_current_thread_as_daemon().unwrap();
 
-    let cb = GlobalRef::from_raw_ptr(&env, ctx);
+    let cb = match take_callback(&env, ctx, 0) {
+        Some(cb) => cb,
+        None => return,
+    };
     let result = (*result).to_java(&env);
 
-    env.call_method(cb.as_obj(), "call", "(LFfiResult;)V", &[result.into()])
+    env.call_method(cb, "call", "(LFfiResult;)V", &[result.into()])
         .unwrap();
 }
 
 unsafe extern "C" fn call_int(ctx: *mut c_void, result: *const backend::FfiResult, arg: i32) {
     let env = JVM.attach_current_thread_as_daemon().unwrap();
 
-    let cb = GlobalRef::from_raw_ptr(&env, ctx);
+    let cb = match take_callback(&env, ctx, 0) {
+        Some(cb) => cb,
+        None => return,
+    };
     let result = (*result).to_java(&env);
     let arg = arg.to_java(&env);
 
     env.call_method(
-        cb.as_obj(),
+        cb,
         "call",
         "(LFfiResult;I)V",
         &[result.into(), arg.into()],
@@ -265,12 +495,15 @@ unsafe extern "C" fn call_String(
 ) {
     let env = JVM.attach_current_thread_as_daemon().unwrap();
 
-    let cb = GlobalRef::from_raw_ptr(&env, ctx);
+    let cb = match take_callback(&env, ctx, 0) {
+        Some(cb) => cb,
+        None => return,
+    };
     let result = (*result).to_java(&env);
     let arg: JObject = arg.to_java(&env).into();
 
     env.call_method(
-        cb.as_obj(),
+        cb,
         "call",
         "(LFfiResult;Ljava/lang/String;)V",
         &[result.into(), arg.into()],
@@ -284,12 +517,15 @@ unsafe extern "C" fn call_Key(
 ) {
     let env = JVM.attach_current_thread_as_daemon().unwrap();
 
-    let cb = GlobalRef::from_raw_ptr(&env, ctx);
+    let cb = match take_callback(&env, ctx, 0) {
+        Some(cb) => cb,
+        None => return,
+    };
     let result = (*result).to_java(&env);
     let arg = (*arg).to_java(&env);
 
     env.call_method(
-        cb.as_obj(),
+        cb,
         "call",
         "(LFfiResult;LKey;)V",
         &[result.into(), arg.into()],
@@ -304,12 +540,15 @@ unsafe extern "C" fn call_array_int(
 ) {
     let env = JVM.attach_current_thread_as_daemon().unwrap();
 
-    let cb = GlobalRef::from_raw_ptr(&env, ctx);
+    let cb = match take_callback(&env, ctx, 0) {
+        Some(cb) => cb,
+        None => return,
+    };
     let result = (*result).to_java(&env);
     let arg = slice::from_raw_parts(arg0, arg1).to_java(&env);
 
     env.call_method(
-        cb.as_obj(),
+        cb,
         "call",
         "(LFfiResult;[I)V",
         &[result.into(), arg.into()],
@@ -324,18 +563,44 @@ unsafe extern "C" fn call_array_Key(
 ) {
     let env = JVM.attach_current_thread_as_daemon().unwrap();
 
-    let cb = GlobalRef::from_raw_ptr(&env, ctx);
+    let cb = match take_callback(&env, ctx, 0) {
+        Some(cb) => cb,
+        None => return,
+    };
     let result = (*result).to_java(&env);
     let arg = slice::from_raw_parts(arg0, arg1).to_java(&env);
 
     env.call_method(
-        cb.as_obj(),
+        cb,
         "call",
         "(LFfiResult;[LKey;)V",
         &[result.into(), arg.into()],
     ).unwrap();
 }
 
+unsafe extern "C" fn call_KeyArray(
+    ctx: *mut c_void,
+    result: *const backend::FfiResult,
+    arg0: *const backend::Key,
+    arg1: usize,
+) {
+    let env = JVM.attach_current_thread_as_daemon().unwrap();
+
+    let cb = match take_callback(&env, ctx, 0) {
+        Some(cb) => cb,
+        None => return,
+    };
+    let result = (*result).to_java(&env);
+    let arg = PackedKeys(slice::from_raw_parts(arg0, arg1)).to_java(&env);
+
+    env.call_method(
+        cb,
+        "call",
+        "(LFfiResult;LKeyArray;)V",
+        &[result.into(), arg.into()],
+    ).unwrap();
+}
+
 unsafe extern "C" fn call_int_String_Key(
     ctx: *mut c_void,
     result: *const backend::FfiResult,
@@ -345,20 +610,54 @@ unsafe extern "C" fn call_int_String_Key(
 ) {
     let env = JVM.attach_current_thread_as_daemon().unwrap();
 
-    let cb = GlobalRef::from_raw_ptr(&env, ctx);
+    let cb = match take_callback(&env, ctx, 0) {
+        Some(cb) => cb,
+        None => return,
+    };
     let result = (*result).to_java(&env);
     let arg0 = arg0.to_java(&env);
     let arg1: JObject = arg1.to_java(&env).into();
     let arg2 = (*arg2).to_java(&env);
 
     env.call_method(
-        cb.as_obj(),
+        cb,
         "call",
         "(LFfiResult;ILjava/lang/String;LKey;)V",
         &[result.into(), arg0.into(), arg1.into(), arg2.into()],
     ).unwrap();
 }
 
+unsafe extern "C" fn call_AppInfos(
+    ctx: *mut c_void,
+    result: *const backend::FfiResult,
+    arg0: *const i32,
+    arg1: *const backend::AppInfo,
+    arg2: usize,
+) {
+    let env = JVM.attach_current_thread_as_daemon().unwrap();
+
+    let cb = match take_callback(&env, ctx, 0) {
+        Some(cb) => cb,
+        None => return,
+    };
+    let result = (*result).to_java(&env);
+    let codes = slice::from_raw_parts(arg0, arg2).to_java(&env);
+    let infos = PackedAppInfos(slice::from_raw_parts(arg1, arg2));
+
+    env.call_method(
+        cb,
+        "call",
+        "(LFfiResult;[I[I[Ljava/lang/String;LKeyArray;)V",
+        &[
+            result.into(),
+            codes.into(),
+            infos.ids(&env).into(),
+            infos.names(&env).into(),
+            infos.keys(&env).into(),
+        ],
+    ).unwrap();
+}
+
 unsafe extern "C" fn call_createAccount_0(
     ctx: *mut c_void,
     result: *const backend::FfiResult,
@@ -366,43 +665,112 @@ unsafe extern "C" fn call_createAccount_0(
 ) {
     let env = JVM.attach_current_thread_as_daemon().unwrap();
 
-    let mut cbs = Box::from_raw(ctx as *mut [Option<GlobalRef>; 2]);
+    let cb = match take_callback(&env, ctx, 0) {
+        Some(cb) => cb,
+        None => return,
+    };
     let result = (*result).to_java(&env);
     let arg = (*arg).to_java(&env);
 
-    if let Some(cb) = cbs[0].take() {
-        env.call_method(
-            cb.as_obj(),
-            "call",
-            "(LFfiResult;LAppInfo;)V",
-            &[result.into(), arg.into()],
-        ).unwrap();
-    }
-
-    // Prevent the context to be destroyed unless all callbacks have been called.
-    if cbs.iter().any(|cb| cb.is_some()) {
-        mem::forget(cbs);
-    }
+    env.call_method(
+        cb,
+        "call",
+        "(LFfiResult;LAppInfo;)V",
+        &[result.into(), arg.into()],
+    ).unwrap();
 }
 
 unsafe extern "C" fn call_createAccount_1(ctx: *mut c_void, result: *const backend::FfiResult) {
     let env = JVM.attach_current_thread_as_daemon().unwrap();
 
-    let mut cbs = Box::from_raw(ctx as *mut [Option<GlobalRef>; 2]);
+    let cb = match take_callback(&env, ctx, 1) {
+        Some(cb) => cb,
+        None => return,
+    };
     let result = (*result).to_java(&env);
 
-    if let Some(cb) = cbs[1].take() {
-        env.call_method(cb.as_obj(), "call", "(LFfiResult;)V", &[result.into()])
-            .unwrap();
-    }
+    env.call_method(cb, "call", "(LFfiResult;)V", &[result.into()])
+        .unwrap();
+}
+
+// Called once per batch of events, with the same context for the whole
+// session. The callback is taken on the last call only.
+unsafe extern "C" fn call_CreateAccountEvents(
+    ctx: *mut c_void,
+    result: *const backend::FfiResult,
+    arg0: *const backend::CreateAccountEvent,
+    arg1: usize,
+) {
+    let env = JVM.attach_current_thread_as_daemon().unwrap();
+
+    let events = slice::from_raw_parts(arg0, arg1);
+    let last = (*result).error_code != 0 || events.last().map_or(false, |event| {
+        event.type_ == backend::CREATE_ACCOUNT_DISCONNECT as i32
+    });
+
+    let cb = if last {
+        take_callback(&env, ctx, 0)
+    } else {
+        get_callback(&env, ctx, 0)
+    };
+    let cb = match cb {
+        Some(cb) => cb,
+        None => return,
+    };
+    let result = (*result).to_java(&env);
+    let arg = events.to_java(&env);
 
-    // Prevent the context to be destroyed unless all callbacks have been called.
-    if cbs.iter().any(|cb| cb.is_some()) {
-        mem::forget(cbs);
+    env.call_method(
+        cb,
+        "call",
+        "(LFfiResult;[LCreateAccountEvent;)V",
+        &[result.into(), arg.into()],
+    ).unwrap();
+}
+
+// Callback of a call that borrows a Java direct buffer. The buffer is the
+// second object of the registry slot, kept there until the call completes.
+unsafe extern "C" fn call_direct(ctx: *mut c_void, result: *const backend::FfiResult) {
+    let env = JVM.attach_current_thread_as_daemon().unwrap();
+
+    if let Some(buf) = take_callback(&env, ctx, 1) {
+        env.delete_local_ref(buf).unwrap();
     }
+
+    call(ctx, result);
+}
+
+// Callbacks of the polled completion mode. The context is the request id.
+unsafe extern "C" fn complete(ctx: *mut c_void, result: *const backend::FfiResult) {
+    backend::completion_queue_push(COMPLETIONS, ctx as u64, result, ptr::null(), 0);
+}
+
+unsafe extern "C" fn complete_int(ctx: *mut c_void, result: *const backend::FfiResult, arg: i32) {
+    backend::completion_queue_push(
+        COMPLETIONS,
+        ctx as u64,
+        result,
+        &arg as *const i32 as *const c_void,
+        mem::size_of::<i32>(),
+    );
+}
+
+unsafe extern "C" fn complete_Key(
+    ctx: *mut c_void,
+    result: *const backend::FfiResult,
+    arg: *const backend::Key,
+) {
+    backend::completion_queue_push(
+        COMPLETIONS,
+        ctx as u64,
+        result,
+        arg as *const c_void,
+        mem::size_of::<backend::Key>(),
+    );
 }
 
 static mut JVM: JavaVM = JAVA_VM_INIT;
+static mut COMPLETIONS: *mut backend::CompletionQueue = 0 as *mut _;
 
 #[no_mangle]
 // This is called when `loadLibrary` is called on the Java side.
@@ -414,15 +782,71 @@ pub unsafe extern "C" fn JNI_OnLoad(
     jni::sys::JNI_VERSION_1_4
 }
 
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_backendInit(
+    _env: JNIEnv,
+    _class: JClass,
+    num_threads: jni::sys::jint,
+) {
+    backend::backend_init(num_threads as usize);
+}
+
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_backendShutdown(_env: JNIEnv, _class: JClass) {
+    backend::backend_shutdown();
+}
+
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_getStats(
+    env: JNIEnv,
+    _class: JClass,
+) -> jni::sys::jobjectArray {
+    let mut stats: Vec<backend::OpStats> = (0..64).map(|_| mem::zeroed()).collect();
+    let len = backend::backend_get_stats(stats.as_mut_ptr(), stats.len());
+    stats.truncate(len);
+
+    stats.as_slice().to_java(&env).into_inner() as jni::sys::jobjectArray
+}
+
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_setLimits(
+    _env: JNIEnv,
+    _class: JClass,
+    max_requests: jni::sys::jlong,
+    max_bytes: jni::sys::jlong,
+) {
+    backend::backend_set_limits(max_requests as usize, max_bytes as usize);
+}
+
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_setAdmissionPolicy(
+    _env: JNIEnv,
+    _class: JClass,
+    policy: jni::sys::jint,
+) {
+    backend::backend_set_admission_policy(policy as backend::AdmissionPolicy);
+}
+
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_getAdmission(
+    env: JNIEnv,
+    _class: JClass,
+) -> jni::sys::jobject {
+    let mut stats: backend::AdmissionStats = mem::zeroed();
+    backend::backend_get_admission(&mut stats);
+
+    stats.to_java(&env).into_inner()
+}
+
 #[no_mangle]
 pub unsafe extern "system" fn Java_NativeBindings_registerApp(
     env: JNIEnv,
     _class: JClass,
     app_info: JObject,
-    cb: JObject,
+    cb: jni::sys::jlong,
 ) {
     let app_info = backend::AppInfo::from_java(&env, app_info);
-    let ctx = gen_ctx!(env, cb);
+    let ctx = to_context(cb);
 
     backend::register_app(&app_info, ctx, Some(call))
 }
@@ -432,10 +856,10 @@ pub unsafe extern "system" fn Java_NativeBindings_getAppId(
     env: JNIEnv,
     _class: JClass,
     app_info: JObject,
-    cb: JObject,
+    cb: jni::sys::jlong,
 ) {
     let app_info = backend::AppInfo::from_java(&env, app_info);
-    let ctx = gen_ctx!(env, cb);
+    let ctx = to_context(cb);
 
     backend::get_app_id(&app_info, ctx, Some(call_int));
 }
@@ -445,10 +869,10 @@ pub unsafe extern "system" fn Java_NativeBindings_getAppName(
     env: JNIEnv,
     _class: JClass,
     app_info: JObject,
-    cb: JObject,
+    cb: jni::sys::jlong,
 ) {
     let app_info = backend::AppInfo::from_java(&env, app_info);
-    let ctx = gen_ctx!(env, cb);
+    let ctx = to_context(cb);
 
     backend::get_app_name(&app_info, ctx, Some(call_String));
 }
@@ -458,10 +882,10 @@ pub unsafe extern "system" fn Java_NativeBindings_getAppKey(
     env: JNIEnv,
     _class: JClass,
     app_info: JObject,
-    cb: JObject,
+    cb: jni::sys::jlong,
 ) {
     let app_info = backend::AppInfo::from_java(&env, app_info);
-    let ctx = gen_ctx!(env, cb);
+    let ctx = to_context(cb);
 
     backend::get_app_key(&app_info, ctx, Some(call_Key));
 }
@@ -470,9 +894,9 @@ pub unsafe extern "system" fn Java_NativeBindings_getAppKey(
 pub unsafe extern "system" fn Java_NativeBindings_randomNumbers(
     env: JNIEnv,
     _class: JClass,
-    cb: JObject,
+    cb: jni::sys::jlong,
 ) {
-    let ctx = gen_ctx!(env, cb);
+    let ctx = to_context(cb);
     backend::random_numbers(ctx, Some(call_array_int));
 }
 
@@ -480,21 +904,142 @@ pub unsafe extern "system" fn Java_NativeBindings_randomNumbers(
 pub unsafe extern "system" fn Java_NativeBindings_randomKeys(
     env: JNIEnv,
     _class: JClass,
-    cb: JObject,
+    cb: jni::sys::jlong,
 ) {
-    let ctx = gen_ctx!(env, cb);
+    let ctx = to_context(cb);
     backend::random_keys(ctx, Some(call_array_Key));
 }
 
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_randomKeysPacked(
+    env: JNIEnv,
+    _class: JClass,
+    cb: jni::sys::jlong,
+) {
+    let ctx = to_context(cb);
+    backend::random_keys(ctx, Some(call_KeyArray));
+}
+
+// Outputs of at least this many bytes are filled over the pool by the backend,
+// which would keep the GC waiting on a critical region for the whole fill. They
+// are filled in native memory instead and copied out one slice of this size at
+// a time. Shorter ones are filled in place, in a critical region: the fill
+// makes no JNI calls.
+const CRITICAL_FILL_MAX: jni::sys::jint = 1 << 20;
+
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_randomNumbersInto(
+    env: JNIEnv,
+    _class: JClass,
+    seed: jni::sys::jlong,
+    out: jni::sys::jintArray,
+    offset: jni::sys::jint,
+    count: jni::sys::jint,
+) {
+    let slice = CRITICAL_FILL_MAX / mem::size_of::<i32>() as jni::sys::jint;
+
+    if count < slice {
+        let jni_env = env.get_native_interface();
+        let ptr = (**jni_env).GetPrimitiveArrayCritical.unwrap()(jni_env, out, ptr::null_mut())
+            as *mut i32;
+        assert!(!ptr.is_null());
+
+        backend::random_numbers_fill(seed as u64, ptr.offset(offset as isize), count as usize);
+
+        (**jni_env).ReleasePrimitiveArrayCritical.unwrap()(jni_env, out, ptr as *mut c_void, 0);
+        return;
+    }
+
+    let mut data = vec![0i32; count as usize];
+    backend::random_numbers_fill(seed as u64, data.as_mut_ptr(), data.len());
+
+    for (index, chunk) in data.chunks(slice as usize).enumerate() {
+        let start = offset + index as jni::sys::jint * slice;
+        env.set_int_array_region(out, start, chunk).unwrap();
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_randomNumbersIntoDirect(
+    env: JNIEnv,
+    _class: JClass,
+    seed: jni::sys::jlong,
+    out: jni::sys::jobject,
+    offset: jni::sys::jint,
+    count: jni::sys::jint,
+) {
+    // Not necessarily a `ByteBuffer`, so the address is queried directly.
+    let jni_env = env.get_native_interface();
+    let ptr = (**jni_env).GetDirectBufferAddress.unwrap()(jni_env, out) as *mut u8;
+    assert!(!ptr.is_null());
+
+    backend::random_numbers_fill(
+        seed as u64,
+        ptr.offset(offset as isize) as *mut i32,
+        count as usize,
+    );
+}
+
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_randomKeysInto(
+    env: JNIEnv,
+    _class: JClass,
+    seed: jni::sys::jlong,
+    out: jni::sys::jbyteArray,
+    offset: jni::sys::jint,
+    count: jni::sys::jint,
+) {
+    let len = count * mem::size_of::<backend::Key>() as jni::sys::jint;
+
+    if len < CRITICAL_FILL_MAX {
+        let jni_env = env.get_native_interface();
+        let ptr = (**jni_env).GetPrimitiveArrayCritical.unwrap()(jni_env, out, ptr::null_mut())
+            as *mut u8;
+        assert!(!ptr.is_null());
+
+        backend::random_keys_fill(
+            seed as u64,
+            ptr.offset(offset as isize) as *mut backend::Key,
+            count as usize,
+        );
+
+        (**jni_env).ReleasePrimitiveArrayCritical.unwrap()(jni_env, out, ptr as *mut c_void, 0);
+        return;
+    }
+
+    let mut data = vec![0i8; len as usize];
+    backend::random_keys_fill(seed as u64, data.as_mut_ptr() as *mut backend::Key, count as usize);
+
+    for (index, chunk) in data.chunks(CRITICAL_FILL_MAX as usize).enumerate() {
+        let start = offset + index as jni::sys::jint * CRITICAL_FILL_MAX;
+        env.set_byte_array_region(out, start, chunk).unwrap();
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_randomKeysIntoDirect(
+    env: JNIEnv,
+    _class: JClass,
+    seed: jni::sys::jlong,
+    out: JByteBuffer,
+    offset: jni::sys::jint,
+    count: jni::sys::jint,
+) {
+    let out = env.get_direct_buffer_address(out).unwrap();
+    let ptr = out.as_mut_ptr().offset(offset as isize);
+
+    backend::random_keys_fill(seed as u64, ptr as *mut backend::Key, count as usize);
+}
+
 #[no_mangle]
 pub unsafe extern "system" fn Java_NativeBindings_getAppInfo(
     env: JNIEnv,
     _class: JClass,
     app_info: JObject,
-    cb: JObject,
+    cb: jni::sys::jlong,
 ) {
     let app_info = backend::AppInfo::from_java(&env, app_info);
-    let ctx = gen_ctx!(env, cb);
+    let ctx = to_context(cb);
 
     backend::get_app_info(&app_info, ctx, Some(call_int_String_Key));
 }
@@ -505,12 +1050,11 @@ pub unsafe extern "system" fn Java_NativeBindings_createAccount(
     _class: JClass,
     arg0: JString,
     arg1: JString,
-    cb0: JObject,
-    cb1: JObject,
+    cbs: jni::sys::jlong,
 ) {
     let arg0 = CString::from_java(&env, arg0);
     let arg1 = CString::from_java(&env, arg1);
-    let ctx = gen_ctx!(env, cb0, cb1);
+    let ctx = to_context(cbs);
 
     backend::create_account(
         arg0.as_ptr(),
@@ -521,19 +1065,158 @@ pub unsafe extern "system" fn Java_NativeBindings_createAccount(
     );
 }
 
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_createAccount2(
+    env: JNIEnv,
+    _class: JClass,
+    arg0: JString,
+    arg1: JString,
+    cb: jni::sys::jlong,
+) {
+    let arg0 = CString::from_java(&env, arg0);
+    let arg1 = CString::from_java(&env, arg1);
+    let ctx = to_context(cb);
+
+    backend::create_account_2(arg0.as_ptr(), arg1.as_ptr(), ctx, Some(call_CreateAccountEvents));
+}
+
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_registerApps(
+    env: JNIEnv,
+    _class: JClass,
+    arg: JObject,
+    cb: jni::sys::jlong,
+) {
+    let arg = Vec::<backend::AppInfo>::from_java(&env, arg);
+    let ctx = to_context(cb);
+
+    backend::register_apps(arg.as_ptr(), arg.len(), ctx, Some(call_array_int));
+}
+
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_getAppInfos(
+    env: JNIEnv,
+    _class: JClass,
+    arg: JObject,
+    cb: jni::sys::jlong,
+) {
+    let arg = Vec::<backend::AppInfo>::from_java(&env, arg);
+    let ctx = to_context(cb);
+
+    backend::get_app_infos(arg.as_ptr(), arg.len(), ctx, Some(call_AppInfos));
+}
+
 #[no_mangle]
 pub unsafe extern "system" fn Java_NativeBindings_verifySignature(
     env: JNIEnv,
     _class: JClass,
     arg: JObject,
-    cb: JObject,
+    offset: jni::sys::jint,
+    len: jni::sys::jint,
+    cb: jni::sys::jlong,
 ) {
     // TODO: instead of copying the data from the java array, we can "borrow" it
     // and then release it at the end - potentially avoiding the copy.
-    let arg = Vec::from_java(&env, arg);
-    let ctx = gen_ctx!(env, cb);
+    let mut data = vec![0i8; len as usize];
+    env.get_byte_array_region(arg.into_inner() as jni::sys::jbyteArray, offset, &mut data)
+        .unwrap();
+    let ctx = to_context(cb);
+
+    backend::verify_signature(data.as_ptr() as *const u8, data.len(), ctx, Some(call));
+}
+
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_verifySignatureDirect(
+    env: JNIEnv,
+    _class: JClass,
+    arg: JByteBuffer,
+    cb: jni::sys::jlong,
+) {
+    let data = env.get_direct_buffer_address(arg).unwrap();
+    let (ptr, len) = (data.as_ptr(), data.len());
+
+    let ctx = to_context(cb);
+
+    backend::verify_signature_borrowed(ptr, len, ctx, Some(call_direct));
+}
+
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_newVerifySession(
+    _env: JNIEnv,
+    _class: JClass,
+) -> jni::sys::jlong {
+    backend::verify_signature_begin() as jni::sys::jlong
+}
+
+// Longest slice of a `byte[]` chunk scanned in one critical region.
+const CRITICAL_SCAN_MAX: jni::sys::jint = 1 << 20;
+
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_verifySignatureUpdate(
+    env: JNIEnv,
+    _class: JClass,
+    session: jni::sys::jlong,
+    chunk: jni::sys::jbyteArray,
+    offset: jni::sys::jint,
+    len: jni::sys::jint,
+) {
+    // Each slice is scanned before `verify_signature_update` returns, without
+    // any JNI calls, so the array can be held in a critical region. The slices
+    // are short enough to be scanned on this thread rather than over the pool,
+    // which keeps the GC waiting for one slice at a time. `offset` and `len` are
+    // checked by the Java side.
+    let jni_env = env.get_native_interface();
+    let mut done = 0;
+
+    while done < len {
+        let slice = cmp::min(len - done, CRITICAL_SCAN_MAX);
+
+        let ptr = (**jni_env).GetPrimitiveArrayCritical.unwrap()(jni_env, chunk, ptr::null_mut())
+            as *const u8;
+        assert!(!ptr.is_null());
+
+        backend::verify_signature_update(
+            session as *mut backend::VerifySession,
+            ptr.offset((offset + done) as isize),
+            slice as usize,
+        );
+
+        (**jni_env).ReleasePrimitiveArrayCritical.unwrap()(
+            jni_env,
+            chunk,
+            ptr as *mut c_void,
+            jni::sys::JNI_ABORT,
+        );
+
+        done += slice;
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_verifySignatureUpdateDirect(
+    env: JNIEnv,
+    _class: JClass,
+    session: jni::sys::jlong,
+    chunk: JByteBuffer,
+    offset: jni::sys::jint,
+    len: jni::sys::jint,
+) {
+    let data = env.get_direct_buffer_address(chunk).unwrap();
+    let ptr = data.as_ptr().offset(offset as isize);
+
+    backend::verify_signature_update(session as *mut backend::VerifySession, ptr, len as usize);
+}
+
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_verifySignatureFinish(
+    _env: JNIEnv,
+    _class: JClass,
+    session: jni::sys::jlong,
+    cb: jni::sys::jlong,
+) {
+    let ctx = to_context(cb);
 
-    backend::verify_signature(arg.as_ptr(), arg.len(), ctx, Some(call));
+    backend::verify_signature_finish(session as *mut backend::VerifySession, ctx, Some(call));
 }
 
 #[no_mangle]
@@ -541,10 +1224,187 @@ pub unsafe extern "system" fn Java_NativeBindings_verifyKeys(
     env: JNIEnv,
     _class: JClass,
     arg: JObject,
-    cb: JObject,
+    cb: jni::sys::jlong,
 ) {
     let arg = Vec::from_java(&env, arg);
-    let ctx = gen_ctx!(env, cb);
+    let ctx = to_context(cb);
 
     backend::verify_keys(arg.as_ptr(), arg.len(), ctx, Some(call));
 }
+
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_verifyKeysPacked(
+    env: JNIEnv,
+    _class: JClass,
+    arg: JObject,
+    cb: jni::sys::jlong,
+) {
+    let bytes = env.get_field(arg, "bytes", "[B").unwrap().l().unwrap();
+    let bytes = Vec::<u8>::from_java(&env, bytes);
+    let len = bytes.len() / mem::size_of::<backend::Key>();
+    let ctx = to_context(cb);
+
+    backend::verify_keys(bytes.as_ptr() as *const backend::Key, len, ctx, Some(call));
+}
+
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_findInvalidKeys(
+    env: JNIEnv,
+    _class: JClass,
+    arg: JObject,
+    cb: jni::sys::jlong,
+) {
+    let arg = Vec::from_java(&env, arg);
+    let ctx = to_context(cb);
+
+    backend::find_invalid_keys(arg.as_ptr(), arg.len(), ctx, Some(call_array_int));
+}
+
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_findInvalidKeysPacked(
+    env: JNIEnv,
+    _class: JClass,
+    arg: JObject,
+    cb: jni::sys::jlong,
+) {
+    let bytes = env.get_field(arg, "bytes", "[B").unwrap().l().unwrap();
+    let bytes = Vec::<u8>::from_java(&env, bytes);
+    let len = bytes.len() / mem::size_of::<backend::Key>();
+    let ctx = to_context(cb);
+
+    backend::find_invalid_keys(
+        bytes.as_ptr() as *const backend::Key,
+        len,
+        ctx,
+        Some(call_array_int),
+    );
+}
+
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_verifySignatureFile(
+    env: JNIEnv,
+    _class: JClass,
+    path: JString,
+    cb: jni::sys::jlong,
+) {
+    let path = CString::from_java(&env, path);
+    let ctx = to_context(cb);
+
+    backend::verify_signature_file(path.as_ptr(), ctx, Some(call));
+}
+
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_verifyKeysFile(
+    env: JNIEnv,
+    _class: JClass,
+    path: JString,
+    cb: jni::sys::jlong,
+) {
+    let path = CString::from_java(&env, path);
+    let ctx = to_context(cb);
+
+    backend::verify_keys_file(path.as_ptr(), ctx, Some(call));
+}
+
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_completionQueueInit(
+    _env: JNIEnv,
+    _class: JClass,
+    capacity: jni::sys::jint,
+) {
+    if COMPLETIONS.is_null() {
+        COMPLETIONS = backend::completion_queue_new(capacity as usize);
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_pollCompletions(
+    env: JNIEnv,
+    _class: JClass,
+    out: JByteBuffer,
+) -> jni::sys::jint {
+    if COMPLETIONS.is_null() {
+        return 0;
+    }
+
+    let out = env.get_direct_buffer_address(out).unwrap();
+    let max = out.len() / mem::size_of::<backend::Completion>();
+
+    backend::completion_queue_poll(
+        COMPLETIONS,
+        out.as_mut_ptr() as *mut backend::Completion,
+        max,
+    ) as jni::sys::jint
+}
+
+// The polled calls push their results into `COMPLETIONS`, so the queue must
+// exist before any of them is issued. Throws otherwise.
+unsafe fn check_completions(env: &JNIEnv) -> bool {
+    if COMPLETIONS.is_null() {
+        env.throw_new("java/lang/IllegalStateException", "completionQueueInit was not called")
+            .unwrap();
+        return false;
+    }
+
+    true
+}
+
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_registerAppPolled(
+    env: JNIEnv,
+    _class: JClass,
+    app_info: JObject,
+    request_id: jni::sys::jlong,
+) {
+    if !check_completions(&env) {
+        return;
+    }
+
+    let app_info = backend::AppInfo::from_java(&env, app_info);
+    backend::register_app(&app_info, request_id as *mut c_void, Some(complete));
+}
+
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_getAppIdPolled(
+    env: JNIEnv,
+    _class: JClass,
+    app_info: JObject,
+    request_id: jni::sys::jlong,
+) {
+    if !check_completions(&env) {
+        return;
+    }
+
+    let app_info = backend::AppInfo::from_java(&env, app_info);
+    backend::get_app_id(&app_info, request_id as *mut c_void, Some(complete_int));
+}
+
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_getAppKeyPolled(
+    env: JNIEnv,
+    _class: JClass,
+    app_info: JObject,
+    request_id: jni::sys::jlong,
+) {
+    if !check_completions(&env) {
+        return;
+    }
+
+    let app_info = backend::AppInfo::from_java(&env, app_info);
+    backend::get_app_key(&app_info, request_id as *mut c_void, Some(complete_Key));
+}
+
+#[no_mangle]
+pub unsafe extern "system" fn Java_NativeBindings_verifySignaturePolled(
+    env: JNIEnv,
+    _class: JClass,
+    arg: JObject,
+    request_id: jni::sys::jlong,
+) {
+    if !check_completions(&env) {
+        return;
+    }
+
+    let arg = Vec::from_java(&env, arg);
+    backend::verify_signature(arg.as_ptr(), arg.len(), request_id as *mut c_void, Some(complete));
+}
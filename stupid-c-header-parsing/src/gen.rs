@@ -0,0 +1,792 @@
+// Generates the JNI bindings of a header: `frontend.cxx`, from the template
+// next to the sources, `NativeBindings.java` and the `Callback_*.java`
+// interfaces.
+//
+// The glue follows the hand-written bindings: the classes and IDs are cached
+// once, in `JNI_OnLoad`, arrays of structs cross the boundary as primitive
+// arrays, and the calls without a callback borrow their array arguments
+// through a critical region instead of copying them.
+
+use parse::{self, Function, Header, Param};
+use std::collections::BTreeMap;
+
+const TEMPLATE: &'static str = include_str!("../templates/frontend.cxx");
+const BANNER: &'static str =
+    "// Generated from backend.h by stupid-c-header-parsing. Do not edit.\n";
+// Longer lines are wrapped, one parameter per line.
+const MAX_LINE: usize = 100;
+
+// Functions not bound although their types are supported, like SWIG's
+// `%ignore`.
+const IGNORED: &'static [(&'static str, &'static str)] = &[
+    (
+        "verify_signature_borrowed",
+        "the input must outlive the call",
+    ),
+    ("create_account_2", "the callback is called more than once"),
+];
+
+pub struct Bindings {
+    pub frontend: String,
+    pub native_bindings: String,
+    // By class name.
+    pub interfaces: BTreeMap<String, String>,
+    // The functions left out, with the reason.
+    pub skipped: Vec<(String, String)>,
+}
+
+struct Interface {
+    // C++ types of the arguments after the `FfiResult`.
+    types: Vec<String>,
+    // Java parameters after the `FfiResult`.
+    params: Vec<String>,
+}
+
+// A parameter of the native method, with the code passing it to the backend.
+#[derive(Default)]
+struct Input {
+    jni: String,
+    java: String,
+    arena: bool,
+    // Run first, as they call into the JVM.
+    prepare: Vec<String>,
+    // Then the critical regions, released in reverse order after the call.
+    acquire: Vec<String>,
+    release: Vec<String>,
+    args: Vec<String>,
+}
+
+// A function with its callbacks, if any, as (interface, Java name) pairs.
+struct Native {
+    name: String,
+    ret: String,
+    params: Vec<String>,
+    callbacks: Vec<(String, String)>,
+}
+
+#[derive(Default)]
+struct Generator {
+    interfaces: BTreeMap<String, Interface>,
+    trampolines: BTreeMap<String, String>,
+    wrappers: Vec<String>,
+    natives: Vec<Native>,
+}
+
+pub fn generate(header: &Header) -> Bindings {
+    let mut generator = Generator::default();
+    let mut skipped = Vec::new();
+
+    for function in &header.functions {
+        if let Some(&(_, reason)) = IGNORED.iter().find(|&&(name, _)| name == function.name) {
+            skipped.push((function.name.clone(), reason.to_string()));
+            continue;
+        }
+
+        if let Err(reason) = generator.function(header, function) {
+            skipped.push((function.name.clone(), reason));
+        }
+    }
+
+    Bindings {
+        frontend: generator.frontend(),
+        native_bindings: generator.native_bindings(),
+        interfaces: generator
+            .interfaces
+            .iter()
+            .map(|(name, interface)| {
+                let source = format!(
+                    "{}\npublic interface {} {{\n    public void call({});\n}}\n",
+                    BANNER,
+                    name,
+                    prepend("FfiResult result", &interface.params).join(", ")
+                );
+
+                (name.clone(), source)
+            })
+            .collect(),
+        skipped,
+    }
+}
+
+// `get_app_id` -> `getAppId`.
+fn camel_case(name: &str) -> String {
+    let mut output = String::new();
+
+    for (index, word) in name.split('_').filter(|word| !word.is_empty()).enumerate() {
+        let mut chars = word.chars();
+
+        if index == 0 {
+            output.push_str(word);
+        } else if let Some(first) = chars.next() {
+            output.extend(first.to_uppercase());
+            output.push_str(chars.as_str());
+        }
+    }
+
+    output
+}
+
+fn prepend(first: &str, rest: &[String]) -> Vec<String> {
+    let mut output = vec![first.to_string()];
+    output.extend(rest.iter().cloned());
+    output
+}
+
+// `head(a, b) tail`, or with one item per line, aligned on the parenthesis,
+// if that's too long.
+fn wrap(indent: &str, head: &str, items: &[String], tail: &str) -> String {
+    let line = format!("{}{}({}){}", indent, head, items.join(", "), tail);
+
+    if line.len() <= MAX_LINE {
+        return line;
+    }
+
+    let separator = format!(",\n{}{}", indent, " ".repeat(head.len() + 1));
+
+    format!("{}{}({}){}", indent, head, items.join(&separator), tail)
+}
+
+// The first line of a C++ function definition. Once wrapped, the brace goes on
+// a line of its own.
+fn definition(head: &str, params: &[String]) -> String {
+    let output = wrap("", head, params, " {");
+
+    if output.contains('\n') {
+        format!("{}\n{{", &output[..output.len() - 2])
+    } else {
+        output
+    }
+}
+
+fn scalar(header: &Header, ty: &str) -> Option<(&'static str, &'static str)> {
+    match ty {
+        "int8_t" | "uint8_t" => Some(("jbyte", "byte")),
+        "int32_t" | "uint32_t" | "int" => Some(("jint", "int")),
+        "int64_t" | "uint64_t" | "size_t" => Some(("jlong", "long")),
+        "bool" => Some(("jboolean", "boolean")),
+        _ if header.enums.contains(ty) => Some(("jint", "int")),
+        _ => None,
+    }
+}
+
+// `const Key*` -> (`Key`, true).
+fn pointee(ty: &str) -> Option<(&str, bool)> {
+    if !ty.ends_with('*') {
+        return None;
+    }
+
+    let base = ty[..ty.len() - 1].trim();
+
+    if base.starts_with("const ") {
+        Some((&base["const ".len()..], true))
+    } else {
+        Some((base, false))
+    }
+}
+
+// The Java name of a parameter: `o_connect_cb` -> `connectCb`.
+fn java_name(param: &Param) -> String {
+    match param.name.as_str() {
+        "ptr" => "data".to_string(),
+        name if name.starts_with("o_") => camel_case(&name[2..]),
+        name => camel_case(name),
+    }
+}
+
+fn block(lines: &[&str]) -> String {
+    lines
+        .iter()
+        .map(|line| format!("    {}", line))
+        .collect::<Vec<_>>()
+        .join("\n")
+}
+
+impl Generator {
+    fn function(&mut self, header: &Header, function: &Function) -> Result<(), String> {
+        let name = camel_case(&function.name);
+
+        let (ret_jni, ret_java, ret_cast) = if function.ret == "void" {
+            ("void", "void", String::new())
+        } else if let Some((jni, java)) = scalar(header, &function.ret) {
+            (jni, java, format!("({}) ", jni))
+        } else if pointee(&function.ret).map_or(false, |(base, _)| header.opaque.contains(base)) {
+            ("jlong", "long", "(jlong) (uintptr_t) ".to_string())
+        } else {
+            return Err(format!("unsupported return type `{}`", function.ret));
+        };
+
+        let params = &function.params;
+        // A call with a callback can read its input after returning, and can
+        // call back before, so its arrays are copied instead of borrowed.
+        let has_context = params.iter().any(|param| param.ty == "void*");
+
+        let mut inputs = Vec::new();
+        let mut callbacks = Vec::new();
+        let mut index = 0;
+
+        while index < params.len() {
+            let param = &params[index];
+            let next = params.get(index + 1);
+
+            if param.ty == "void*" {
+                let cbs = &params[index + 1..];
+
+                // Named by a typedef or spelled out.
+                let signatures = cbs
+                    .iter()
+                    .map(|cb| {
+                        header
+                            .callbacks
+                            .get(&cb.ty)
+                            .cloned()
+                            .or_else(|| parse::pointer_params(&cb.ty))
+                    })
+                    .collect::<Option<Vec<_>>>();
+
+                let signatures = match signatures {
+                    Some(ref signatures) if !signatures.is_empty() => signatures,
+                    _ => return Err("a context must be followed by the callbacks".to_string()),
+                };
+
+                if cbs.len() > 2 {
+                    return Err("more than 2 callbacks".to_string());
+                }
+
+                let handle = if cbs.len() == 1 { "cb" } else { "cbs" };
+                let mut input = Input {
+                    jni: format!("jlong {}", handle),
+                    java: format!("long {}", handle),
+                    args: vec![format!("to_context({})", handle)],
+                    ..Input::default()
+                };
+
+                for (cb_index, (cb, signature)) in cbs.iter().zip(signatures).enumerate() {
+                    let (interface, trampoline) = self
+                        .callback(signature, &name, cb_index, cbs.len())
+                        .map_err(|reason| format!("`{}`: {}", cb.ty, reason))?;
+
+                    input.args.push(trampoline);
+                    callbacks.push((interface, java_name(cb)));
+                }
+
+                inputs.push(input);
+                break;
+            }
+
+            if let Some(len) = next.filter(|next| next.ty == "size_t" && param.ty.ends_with('*')) {
+                inputs.push(self.array(param, len, has_context)?);
+                index += 2;
+            } else {
+                inputs.push(self.single(header, param)?);
+                index += 1;
+            }
+        }
+
+        // Native method.
+        let mut jni_params = vec!["JNIEnv* env".to_string(), "jclass klass".to_string()];
+        jni_params.extend(inputs.iter().map(|input| input.jni.clone()));
+
+        let mut blocks = Vec::new();
+
+        if inputs.iter().any(|input| input.arena) {
+            blocks.push(block(&["Arena arena;"]));
+        }
+
+        for input in &inputs {
+            if !input.prepare.is_empty() {
+                blocks.push(block(
+                    &input.prepare.iter().map(String::as_str).collect::<Vec<_>>(),
+                ));
+            }
+        }
+
+        for input in &inputs {
+            if !input.acquire.is_empty() {
+                blocks.push(block(
+                    &input.acquire.iter().map(String::as_str).collect::<Vec<_>>(),
+                ));
+            }
+        }
+
+        let args = inputs
+            .iter()
+            .flat_map(|input| input.args.iter().cloned())
+            .collect::<Vec<_>>();
+        let releases = inputs
+            .iter()
+            .rev()
+            .flat_map(|input| input.release.iter())
+            .collect::<Vec<_>>();
+
+        let call_head = match (ret_jni, releases.is_empty()) {
+            ("void", _) => function.name.clone(),
+            (_, true) => format!("return {}{}", ret_cast, function.name),
+            (_, false) => format!("auto output = {}{}", ret_cast, function.name),
+        };
+        blocks.push(wrap("    ", &call_head, &args, ";"));
+
+        if !releases.is_empty() {
+            blocks.push(block(
+                &releases
+                    .iter()
+                    .map(|line| line.as_str())
+                    .collect::<Vec<_>>(),
+            ));
+
+            if ret_jni != "void" {
+                blocks.push(block(&["return output;"]));
+            }
+        }
+
+        self.wrappers.push(format!(
+            "{}\n{}\n}}",
+            definition(
+                &format!("{} Java_NativeBindings_{}", ret_jni, name),
+                &jni_params
+            ),
+            blocks.join("\n\n")
+        ));
+
+        self.natives.push(Native {
+            name,
+            ret: ret_java.to_string(),
+            params: inputs.iter().map(|input| input.java.clone()).collect(),
+            callbacks,
+        });
+
+        Ok(())
+    }
+
+    fn single(&self, header: &Header, param: &Param) -> Result<Input, String> {
+        let name = &param.name;
+        let java = java_name(param);
+
+        if let Some((jni, java_ty)) = scalar(header, &param.ty) {
+            return Ok(Input {
+                jni: format!("{} {}", jni, name),
+                java: format!("{} {}", java_ty, java),
+                args: vec![format!("({}) {}", param.ty, name)],
+                ..Input::default()
+            });
+        }
+
+        let (base, _) =
+            pointee(&param.ty).ok_or(format!("unsupported parameter type `{}`", param.ty))?;
+
+        let (jni, java_ty, prepare, arena) = match param.ty.as_str() {
+            "const char*" => (
+                "jstring",
+                "String",
+                vec![
+                    format!("char* {};", name),
+                    format!("from_java(env, j_{0}, arena, {0});", name),
+                ],
+                true,
+            ),
+            "const AppInfo*" => (
+                "jobject",
+                "AppInfo",
+                vec![
+                    format!("AppInfo {};", name),
+                    format!("from_java(env, j_{0}, arena, {0});", name),
+                ],
+                true,
+            ),
+            "const Key*" => (
+                "jobject",
+                "Key",
+                vec![
+                    format!("Key {};", name),
+                    format!("from_java(env, j_{0}, {0});", name),
+                ],
+                false,
+            ),
+            _ if header.opaque.contains(base) => {
+                return Ok(Input {
+                    jni: format!("jlong {}", name),
+                    java: format!("long {}", java),
+                    args: vec![format!("({}) (uintptr_t) {}", param.ty, name)],
+                    ..Input::default()
+                });
+            }
+            _ => return Err(format!("unsupported parameter type `{}`", param.ty)),
+        };
+
+        let arg = if param.ty == "const char*" {
+            name.clone()
+        } else {
+            format!("&{}", name)
+        };
+
+        Ok(Input {
+            jni: format!("{} j_{}", jni, name),
+            java: format!("{} {}", java_ty, java),
+            arena,
+            prepare,
+            args: vec![arg],
+            ..Input::default()
+        })
+    }
+
+    // A pointer and its length, as one Java array.
+    fn array(&self, param: &Param, len: &Param, copy: bool) -> Result<Input, String> {
+        let (base, is_const) = pointee(&param.ty).unwrap();
+        let (ptr, len) = (&param.name, &len.name);
+        let unsupported = || format!("unsupported array type `{}`", param.ty);
+
+        let (jni, java_ty) = match base {
+            "int32_t" => ("jintArray", "int[]"),
+            "uint8_t" | "int8_t" => ("jbyteArray", "byte[]"),
+            "Key" => ("jobject", "KeyArray"),
+            "AppInfo" if is_const => ("jobjectArray", "AppInfo[]"),
+            _ => return Err(unsupported()),
+        };
+
+        let mut input = Input {
+            jni: format!("{} j_{}", jni, ptr),
+            java: format!("{} {}", java_ty, java_name(param)),
+            args: vec![ptr.clone(), len.clone()],
+            ..Input::default()
+        };
+
+        // The calls with a callback may still read the input after they
+        // return. Objects can't be borrowed at all.
+        if copy || base == "AppInfo" {
+            if !is_const {
+                return Err(format!("`{}` output with a callback", param.ty));
+            }
+
+            input.arena = true;
+            input.prepare = vec![
+                format!(
+                    "{}* {};",
+                    if base == "int8_t" { "uint8_t" } else { base },
+                    ptr
+                ),
+                format!("size_t {};", len),
+                format!("from_java(env, j_{}, arena, {}, {});", ptr, ptr, len),
+            ];
+
+            if base == "int8_t" {
+                input.args[0] = format!("(const int8_t*) {}", ptr);
+            }
+
+            return Ok(input);
+        }
+
+        // Borrowed for the duration of the call, which mustn't call into the
+        // JVM, so the JNI calls all come first.
+        let array = if base == "Key" {
+            input.prepare = vec![
+                format!("size_t {};", len),
+                format!("auto j_{}_bytes = key_bytes(env, j_{}, {});", ptr, ptr, len),
+            ];
+            format!("j_{}_bytes", ptr)
+        } else {
+            input.prepare = vec![format!(
+                "auto {} = (size_t) env->GetArrayLength(j_{});",
+                len, ptr
+            )];
+            format!("j_{}", ptr)
+        };
+
+        input.acquire = vec![
+            format!(
+                "auto {} = ({}) env->GetPrimitiveArrayCritical({}, nullptr);",
+                ptr, param.ty, array
+            ),
+            format!("assert({});", ptr),
+        ];
+
+        input.release = vec![if is_const {
+            format!(
+                "env->ReleasePrimitiveArrayCritical({}, (void*) {}, JNI_ABORT);",
+                array, ptr
+            )
+        } else {
+            format!("env->ReleasePrimitiveArrayCritical({}, {}, 0);", array, ptr)
+        }];
+
+        Ok(input)
+    }
+
+    // Adds the interface and the trampoline of a callback of `function`,
+    // returning their names. The callbacks of the functions with a single
+    // one share their trampoline.
+    fn callback(
+        &mut self,
+        params: &[String],
+        function: &str,
+        index: usize,
+        count: usize,
+    ) -> Result<(String, String), String> {
+        if params.len() < 2 || params[0] != "void*" || params[1] != "const FfiResult*" {
+            return Err("not a `(void*, const FfiResult*, ...)` callback".to_string());
+        }
+
+        let args = &params[2..];
+
+        // (type, is an array) pairs. A run of pointers followed by a `size_t`
+        // are arrays of that length.
+        let mut items = Vec::new();
+        let mut has_len = false;
+        let mut position = 0;
+
+        while position < args.len() {
+            let is_pointer = |ty: &String| ty.ends_with('*') && ty != "const char*";
+            let end = position
+                + args[position..]
+                    .iter()
+                    .take_while(|ty| is_pointer(ty))
+                    .count();
+
+            if end > position && args.get(end).map_or(false, |ty| ty == "size_t") && !has_len {
+                items.extend(args[position..end].iter().map(|ty| (ty.as_str(), true)));
+                has_len = true;
+                position = end + 1;
+            } else {
+                items.push((args[position].as_str(), false));
+                position += 1;
+            }
+        }
+
+        let mut parts = Vec::new();
+        let mut c_params = vec![
+            "void* ctx".to_string(),
+            "const FfiResult* result".to_string(),
+        ];
+        let mut c_args = Vec::new();
+        let mut interface = Interface {
+            types: Vec::new(),
+            params: Vec::new(),
+        };
+
+        for (item, &(ty, is_array)) in items.iter().enumerate() {
+            let suffix = if items.len() == 1 {
+                String::new()
+            } else {
+                item.to_string()
+            };
+            let name = format!("arg{}", suffix);
+
+            if !is_array {
+                let (part, cxx, java) = match ty {
+                    "int32_t" => ("int", "int32_t", "int"),
+                    "const char*" => ("String", "const char*", "String"),
+                    "const Key*" => ("Key", "const ::Key*", "Key"),
+                    "const AppInfo*" => ("AppInfo", "const ::AppInfo*", "AppInfo"),
+                    _ => return Err(format!("unsupported argument type `{}`", ty)),
+                };
+
+                parts.push(part);
+                c_params.push(format!("{} {}", ty, name));
+                c_args.push(name.clone());
+                interface.types.push(cxx.to_string());
+                interface.params.push(format!("{} {}", java, name));
+                continue;
+            }
+
+            let ptr = format!("ptr{}", suffix);
+            c_params.push(format!("{} {}", ty, ptr));
+
+            match ty {
+                "const int32_t*" => {
+                    parts.push("array_int");
+                    c_args.push(format!("std::make_pair({}, len)", ptr));
+                    interface
+                        .types
+                        .push("std::pair<const int32_t*, size_t>".to_string());
+                    interface.params.push(format!("int[] {}", name));
+                }
+                "const Key*" => {
+                    parts.push("KeyArray");
+                    c_args.push(format!("PackedKeys {{ {}, len }}", ptr));
+                    interface.types.push("PackedKeys".to_string());
+                    interface.params.push(format!("KeyArray {}", name));
+                }
+                "const AppInfo*" => {
+                    parts.push("AppInfos");
+
+                    for &(column, java) in &[
+                        ("Ids", "int[]"),
+                        ("Names", "String[]"),
+                        ("Keys", "KeyArray"),
+                    ] {
+                        c_args.push(format!("AppInfo{} {{ {}, len }}", column, ptr));
+                        interface.types.push(format!("AppInfo{}", column));
+                        interface
+                            .params
+                            .push(format!("{} {}{}", java, name, column));
+                    }
+                }
+                _ => return Err(format!("unsupported array type `{}`", ty)),
+            }
+        }
+
+        if has_len {
+            c_params.push("size_t len".to_string());
+        }
+
+        let name = parts
+            .iter()
+            .fold("Callback".to_string(), |name, part| name + "_" + part);
+        let trampoline = if count == 1 {
+            parts
+                .iter()
+                .fold("call".to_string(), |name, part| name + "_" + part)
+        } else {
+            format!("call_{}_{}", function, index)
+        };
+
+        if !self.trampolines.contains_key(&trampoline) {
+            let mut call_args = vec![
+                format!("cache.{}", name),
+                index.to_string(),
+                "ctx".to_string(),
+                "result".to_string(),
+            ];
+            call_args.extend(c_args);
+
+            let source = format!(
+                "{}\n{}\n}}",
+                definition(&format!("void {}", trampoline), &c_params),
+                wrap("    ", "call_impl", &call_args, ";")
+            );
+
+            self.trampolines.insert(trampoline.clone(), source);
+        }
+
+        self.interfaces.entry(name.clone()).or_insert(interface);
+
+        Ok((name, trampoline))
+    }
+
+    fn frontend(&self) -> String {
+        let mut members = Vec::new();
+        let mut classes = Vec::new();
+        let mut releases = Vec::new();
+
+        for (name, interface) in &self.interfaces {
+            members.push(format!(
+                "    CallbackInterface<{}> {};",
+                interface.types.join(", "),
+                name
+            ));
+            classes.push(format!(
+                "    cache.{0}.klass = find_class(env, \"{0}\");",
+                name
+            ));
+            releases.push(format!("        cache.{}.klass,", name));
+        }
+
+        TEMPLATE
+            .replace("    // @callback_interfaces@", &members.join("\n"))
+            .replace("    // @callback_classes@", &classes.join("\n"))
+            .replace("        // @callback_release@", &releases.join("\n"))
+            .replace(
+                "// @trampolines@",
+                &self
+                    .trampolines
+                    .values()
+                    .cloned()
+                    .collect::<Vec<_>>()
+                    .join("\n\n"),
+            )
+            .replace("// @wrappers@", &self.wrappers.join("\n\n"))
+    }
+
+    fn native_bindings(&self) -> String {
+        let mut sections = Vec::new();
+
+        let direct = self
+            .natives
+            .iter()
+            .filter(|native| native.callbacks.is_empty())
+            .map(|native| {
+                wrap(
+                    "    ",
+                    &format!("public static native {} {}", native.ret, native.name),
+                    &native.params,
+                    ";",
+                )
+            })
+            .collect::<Vec<_>>();
+
+        if !direct.is_empty() {
+            sections.push(direct.join("\n"));
+        }
+
+        let with_callbacks = self
+            .natives
+            .iter()
+            .filter(|native| !native.callbacks.is_empty())
+            .collect::<Vec<_>>();
+
+        if !with_callbacks.is_empty() {
+            for (index, native) in with_callbacks.iter().enumerate() {
+                // The handle is the last parameter.
+                let mut params = native.params[..native.params.len() - 1].to_vec();
+                let mut args = params
+                    .iter()
+                    .map(|param| param.rsplit(' ').next().unwrap().to_string())
+                    .collect::<Vec<_>>();
+
+                params.extend(
+                    native
+                        .callbacks
+                        .iter()
+                        .map(|&(ref interface, ref name)| format!("{} {}", interface, name)),
+                );
+                args.push(format!(
+                    "CallbackRegistry.register({})",
+                    native
+                        .callbacks
+                        .iter()
+                        .map(|&(_, ref name)| name.as_str())
+                        .collect::<Vec<_>>()
+                        .join(", ")
+                ));
+
+                let comment = if index == 0 {
+                    "    // The callbacks are kept in `CallbackRegistry` while the call is in flight.\n    \
+                     // The natives get the handle of their registry slot.\n"
+                } else {
+                    ""
+                };
+
+                sections.push(format!(
+                    "{}{}\n{}\n    }}",
+                    comment,
+                    wrap(
+                        "    ",
+                        &format!("public static {} {}", native.ret, native.name),
+                        &params,
+                        " {"
+                    ),
+                    wrap("        ", &native.name, &args, ";")
+                ));
+            }
+
+            sections.push(
+                with_callbacks
+                    .iter()
+                    .map(|native| {
+                        wrap(
+                            "    ",
+                            &format!("private static native {} {}", native.ret, native.name),
+                            &native.params,
+                            ";",
+                        )
+                    })
+                    .collect::<Vec<_>>()
+                    .join("\n"),
+            );
+        }
+
+        format!(
+            "{}\npublic class NativeBindings {{\n    static {{\n        System.loadLibrary(\"frontend\");\n    }}\n\n{}\n}}\n",
+            BANNER,
+            sections.join("\n\n")
+        )
+    }
+}
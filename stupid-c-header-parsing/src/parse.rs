@@ -0,0 +1,252 @@
+// Reads the declarations of a header out of the doxygen XML of its file
+// (`<name>_8h.xml`).
+
+use std::collections::{BTreeMap, BTreeSet};
+use std::io::Read;
+use xml::reader::{EventReader, XmlEvent};
+
+#[derive(Debug)]
+pub struct Param {
+    pub name: String,
+    // Normalised, e.g. `const AppInfo*`.
+    pub ty: String,
+}
+
+#[derive(Debug)]
+pub struct Function {
+    pub name: String,
+    pub ret: String,
+    pub params: Vec<Param>,
+}
+
+#[derive(Debug, Default)]
+pub struct Header {
+    pub functions: Vec<Function>,
+    // Function pointer typedefs, by name: their parameter types.
+    pub callbacks: BTreeMap<String, Vec<String>>,
+    // Structs defined in the header.
+    pub structs: BTreeSet<String>,
+    // Structs only declared, which can only be passed by pointer.
+    pub opaque: BTreeSet<String>,
+    pub enums: BTreeSet<String>,
+}
+
+struct Element {
+    name: String,
+    attributes: Vec<(String, String)>,
+    children: Vec<Node>,
+}
+
+enum Node {
+    Element(Element),
+    Text(String),
+}
+
+impl Element {
+    fn attribute(&self, name: &str) -> Option<&str> {
+        self.attributes
+            .iter()
+            .find(|&&(ref key, _)| key == name)
+            .map(|&(_, ref value)| value.as_str())
+    }
+
+    fn child(&self, name: &str) -> Option<&Element> {
+        self.elements().find(|element| element.name == name)
+    }
+
+    fn elements<'a>(&'a self) -> Box<dyn Iterator<Item = &'a Element> + 'a> {
+        Box::new(self.children.iter().filter_map(|node| match *node {
+            Node::Element(ref element) => Some(element),
+            Node::Text(_) => None,
+        }))
+    }
+
+    // All the elements below this one, depth first.
+    fn descendants<'a>(&'a self) -> Vec<&'a Element> {
+        let mut output = Vec::new();
+
+        for element in self.elements() {
+            output.push(element);
+            output.extend(element.descendants());
+        }
+
+        output
+    }
+
+    // The text content, with the markup (`<ref>`, ...) stripped.
+    fn text(&self) -> String {
+        let mut output = String::new();
+
+        for node in &self.children {
+            match *node {
+                Node::Element(ref element) => output.push_str(&element.text()),
+                Node::Text(ref text) => output.push_str(text),
+            }
+        }
+
+        output
+    }
+
+    fn child_text(&self, name: &str) -> String {
+        self.child(name).map(Element::text).unwrap_or_default()
+    }
+}
+
+fn read_tree<R: Read>(input: R) -> Result<Element, String> {
+    let mut stack = vec![Element {
+        name: String::new(),
+        attributes: Vec::new(),
+        children: Vec::new(),
+    }];
+
+    for event in EventReader::new(input) {
+        match event.map_err(|error| error.to_string())? {
+            XmlEvent::StartElement {
+                name, attributes, ..
+            } => {
+                stack.push(Element {
+                    name: name.local_name,
+                    attributes: attributes
+                        .into_iter()
+                        .map(|attribute| (attribute.name.local_name, attribute.value))
+                        .collect(),
+                    children: Vec::new(),
+                });
+            }
+            XmlEvent::EndElement { .. } => {
+                let element = stack.pop().unwrap();
+                stack
+                    .last_mut()
+                    .unwrap()
+                    .children
+                    .push(Node::Element(element));
+            }
+            XmlEvent::Characters(text) | XmlEvent::Whitespace(text) | XmlEvent::CData(text) => {
+                stack.last_mut().unwrap().children.push(Node::Text(text));
+            }
+            _ => (),
+        }
+    }
+
+    Ok(stack.pop().unwrap())
+}
+
+// `const  AppInfo *` -> `const AppInfo*`.
+pub fn normalise(ty: &str) -> String {
+    let spaced = ty.replace('*', " * ");
+    let mut output = String::new();
+
+    for token in spaced.split_whitespace() {
+        if token != "*" && !output.is_empty() {
+            output.push(' ');
+        }
+        output.push_str(token);
+    }
+
+    output
+}
+
+// Split a parameter declaration, whose name is optional, into its type and
+// name: `const Key* key` -> (`const Key*`, `key`).
+fn split_param(param: &str) -> (String, String) {
+    let ty = normalise(param);
+    let qualifiers = [
+        "const", "unsigned", "signed", "struct", "enum", "long", "short",
+    ];
+
+    if let Some(index) = ty.rfind(|c| c == ' ' || c == '*') {
+        let (head, name) = ty.split_at(index + 1);
+        let head = head.trim_end();
+
+        if !head.is_empty() && !qualifiers.contains(&head.split(' ').last().unwrap()) {
+            return (head.to_string(), name.to_string());
+        }
+    }
+
+    (ty, String::new())
+}
+
+// The parameter types of a function pointer type or typedef, taken from the
+// last parenthesised list: `void(*)(void* ctx, const FfiResult*)`.
+pub fn pointer_params(declaration: &str) -> Option<Vec<String>> {
+    if !declaration.replace(' ', "").contains("(*") {
+        return None;
+    }
+
+    let end = declaration.rfind(')')?;
+    let begin = declaration[..end].rfind('(')?;
+
+    Some(
+        declaration[begin + 1..end]
+            .split(',')
+            .map(|param| split_param(param).0)
+            .filter(|ty| !ty.is_empty())
+            .collect(),
+    )
+}
+
+pub fn read<R: Read>(input: R) -> Result<Header, String> {
+    let root = read_tree(input)?;
+    let mut header = Header::default();
+    let mut typedef_structs = Vec::new();
+
+    for element in root.descendants() {
+        match element.name.as_str() {
+            "innerclass" => {
+                if element
+                    .attribute("refid")
+                    .map_or(false, |id| id.starts_with("struct"))
+                {
+                    header.structs.insert(element.text());
+                }
+            }
+            "memberdef" => (),
+            _ => continue,
+        }
+
+        let name = element.child_text("name");
+
+        match element.attribute("kind") {
+            Some("function") => {
+                let params = element
+                    .elements()
+                    .filter(|child| child.name == "param")
+                    .map(|param| Param {
+                        name: param.child_text("declname"),
+                        ty: normalise(&param.child_text("type")),
+                    })
+                    .filter(|param| param.ty != "void")
+                    .collect();
+
+                header.functions.push(Function {
+                    name,
+                    ret: normalise(&element.child_text("type")),
+                    params,
+                });
+            }
+            Some("typedef") => {
+                let ty = normalise(&element.child_text("type"));
+
+                if let Some(params) = pointer_params(&element.child_text("definition")) {
+                    header.callbacks.insert(name, params);
+                } else if ty.starts_with("enum ") {
+                    header.enums.insert(name);
+                } else if ty.starts_with("struct ") {
+                    typedef_structs.push(name);
+                }
+            }
+            Some("enum") => {
+                header.enums.insert(name);
+            }
+            _ => (),
+        }
+    }
+
+    for name in typedef_structs {
+        if !header.structs.contains(&name) {
+            header.opaque.insert(name);
+        }
+    }
+
+    Ok(header)
+}
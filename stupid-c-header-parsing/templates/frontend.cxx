@@ -0,0 +1,562 @@
+// Generated from backend.h by stupid-c-header-parsing. Do not edit.
+
+#include <jni.h>
+#include <pthread.h>
+#include <string.h>
+
+#include <cassert>
+#include <utility>
+
+#include "arena.h"
+#include "backend.h"
+
+static JavaVM* jvm = nullptr;
+
+// -----------------------------------------------------------------------------
+// Signatures
+// -----------------------------------------------------------------------------
+
+// JNI type signature of `N` chars, built at compile time.
+template<size_t N>
+struct Signature {
+    char chars[N + 1];
+};
+
+template<size_t N>
+constexpr Signature<N - 1> signature(const char (&input)[N]) {
+    Signature<N - 1> output {};
+
+    for (size_t i = 0; i < N; ++i) {
+        output.chars[i] = input[i];
+    }
+
+    return output;
+}
+
+template<size_t A, size_t B>
+constexpr Signature<A + B> operator + (const Signature<A>& a, const Signature<B>& b) {
+    Signature<A + B> output {};
+
+    for (size_t i = 0; i < A; ++i) {
+        output.chars[i] = a.chars[i];
+    }
+
+    for (size_t i = 0; i <= B; ++i) {
+        output.chars[A + i] = b.chars[i];
+    }
+
+    return output;
+}
+
+constexpr Signature<0> concat() {
+    return signature("");
+}
+
+template<size_t N, typename... R>
+constexpr auto concat(const Signature<N>& first, const R&... rest) {
+    return first + concat(rest...);
+}
+
+// `java_signature(tag<T>())` is the signature of the Java type `T` converts to.
+template<typename T>
+struct tag {};
+
+template<typename... T>
+constexpr auto method_signature() {
+    return signature("(") + concat(java_signature(tag<T>())...) + signature(")V");
+}
+
+// A Java callback interface, whose `call` method takes a `FfiResult` followed
+// by the conversions of `T...`. The method ID is resolved on first use and then
+// kept per instantiation.
+template<typename... T>
+struct CallbackInterface {
+    jclass klass;
+
+    jmethodID call(JNIEnv* env) const {
+        static constexpr auto signature = method_signature<const FfiResult*, T...>();
+        static const jmethodID method = resolve(env, klass, signature.chars);
+
+        return method;
+    }
+
+    static jmethodID resolve(JNIEnv* env, jclass klass, const char* signature) {
+        auto method = env->GetMethodID(klass, "call", signature);
+        assert(method);
+
+        return method;
+    }
+};
+
+// -----------------------------------------------------------------------------
+// Cache
+// -----------------------------------------------------------------------------
+
+struct PackedKeys;
+struct AppInfoIds;
+struct AppInfoNames;
+struct AppInfoKeys;
+
+// Resolved once in `JNI_OnLoad`, so no conversion or callback looks up a class
+// or an ID, and the backend threads, whose `FindClass` can't see the
+// application classes, never need to.
+static struct {
+    struct {
+        jclass klass;
+        jmethodID init;
+        jfieldID errorCode;
+        jfieldID error;
+    } FfiResult;
+
+    struct {
+        jclass klass;
+        jmethodID init;
+        jfieldID bytes;
+    } Key;
+
+    struct {
+        jclass klass;
+        jmethodID init;
+        jfieldID bytes;
+    } KeyArray;
+
+    struct {
+        jclass klass;
+        jmethodID init;
+        jfieldID id;
+        jfieldID name;
+        jfieldID key;
+    } AppInfo;
+
+    struct {
+        jclass klass;
+    } String;
+
+    struct {
+        jclass klass;
+        jmethodID take;
+    } CallbackRegistry;
+
+    // @callback_interfaces@
+} cache;
+
+jclass find_class(JNIEnv* env, const char* name) {
+    auto local = env->FindClass(name);
+    assert(local);
+
+    auto global = (jclass) env->NewGlobalRef(local);
+    env->DeleteLocalRef(local);
+
+    return global;
+}
+
+void cache_init(JNIEnv* env) {
+    cache.FfiResult.klass = find_class(env, "FfiResult");
+    cache.FfiResult.init = env->GetMethodID(cache.FfiResult.klass, "<init>", "()V");
+    cache.FfiResult.errorCode = env->GetFieldID(cache.FfiResult.klass, "errorCode", "I");
+    cache.FfiResult.error = env->GetFieldID(cache.FfiResult.klass, "error", "Ljava/lang/String;");
+    assert(cache.FfiResult.init && cache.FfiResult.errorCode && cache.FfiResult.error);
+
+    cache.Key.klass = find_class(env, "Key");
+    cache.Key.init = env->GetMethodID(cache.Key.klass, "<init>", "()V");
+    cache.Key.bytes = env->GetFieldID(cache.Key.klass, "bytes", "[B");
+    assert(cache.Key.init && cache.Key.bytes);
+
+    cache.KeyArray.klass = find_class(env, "KeyArray");
+    cache.KeyArray.init = env->GetMethodID(cache.KeyArray.klass, "<init>", "([B)V");
+    cache.KeyArray.bytes = env->GetFieldID(cache.KeyArray.klass, "bytes", "[B");
+    assert(cache.KeyArray.init && cache.KeyArray.bytes);
+
+    cache.AppInfo.klass = find_class(env, "AppInfo");
+    cache.AppInfo.init = env->GetMethodID(cache.AppInfo.klass, "<init>", "()V");
+    cache.AppInfo.id = env->GetFieldID(cache.AppInfo.klass, "id", "I");
+    cache.AppInfo.name = env->GetFieldID(cache.AppInfo.klass, "name", "Ljava/lang/String;");
+    cache.AppInfo.key = env->GetFieldID(cache.AppInfo.klass, "key", "LKey;");
+    assert(cache.AppInfo.init && cache.AppInfo.id && cache.AppInfo.name && cache.AppInfo.key);
+
+    cache.String.klass = find_class(env, "java/lang/String");
+
+    cache.CallbackRegistry.klass = find_class(env, "CallbackRegistry");
+    cache.CallbackRegistry.take = env->GetStaticMethodID(cache.CallbackRegistry.klass,
+                                                         "take",
+                                                         "(JI)Ljava/lang/Object;");
+    assert(cache.CallbackRegistry.take);
+
+    // @callback_classes@
+}
+
+void cache_release(JNIEnv* env) {
+    jclass classes[] = {
+        cache.FfiResult.klass,
+        cache.Key.klass,
+        cache.KeyArray.klass,
+        cache.AppInfo.klass,
+        cache.String.klass,
+        cache.CallbackRegistry.klass,
+        // @callback_release@
+    };
+
+    for (auto klass : classes) {
+        if (klass) {
+            env->DeleteGlobalRef(klass);
+        }
+    }
+
+    memset(&cache, 0, sizeof(cache));
+}
+
+// -----------------------------------------------------------------------------
+// Thread attachment
+// -----------------------------------------------------------------------------
+
+static pthread_key_t env_key;
+
+void detach_current_thread(void*) {
+    if (jvm) {
+        jvm->DetachCurrentThread();
+    }
+}
+
+JNIEnv* attach_current_thread() {
+    auto env = (JNIEnv*) pthread_getspecific(env_key);
+    if (env) {
+        return env;
+    }
+
+    if (jvm->GetEnv((void**) &env, JNI_VERSION_1_4) == JNI_OK) {
+        return env;
+    }
+
+    jvm->AttachCurrentThreadAsDaemon((void**) &env, nullptr);
+    assert(env);
+
+    pthread_setspecific(env_key, env);
+    return env;
+}
+
+// -----------------------------------------------------------------------------
+// Conversions
+// -----------------------------------------------------------------------------
+
+jobject new_java_object(JNIEnv* env, jclass klass, jmethodID constructor) {
+    auto output = env->NewObject(klass, constructor);
+    assert(output);
+
+    return output;
+}
+
+// int
+// -----------------------------------------------------------------------------
+constexpr auto java_signature(tag<int32_t>) { return signature("I"); }
+
+jint to_java(JNIEnv*, int32_t input) {
+    return (jint) input;
+}
+
+// char*
+// -----------------------------------------------------------------------------
+constexpr auto java_signature(tag<const char*>) { return signature("Ljava/lang/String;"); }
+
+jstring to_java(JNIEnv* env, const char* input) {
+    return env->NewStringUTF(input);
+}
+
+// Copied into `arena`. A null string becomes an empty one.
+void from_java(JNIEnv* env, jstring input, Arena& arena, char*& output) {
+    if (!input) {
+        output = (char*) arena.allocate(1, 1);
+        output[0] = '\0';
+        return;
+    }
+
+    auto len = env->GetStringLength(input);
+    auto size = (size_t) env->GetStringUTFLength(input);
+
+    output = (char*) arena.allocate(size + 1, 1);
+    env->GetStringUTFRegion(input, 0, len, output);
+    output[size] = '\0';
+}
+
+// array of int
+// -----------------------------------------------------------------------------
+constexpr auto java_signature(tag<std::pair<const int32_t*, size_t>>) { return signature("[I"); }
+
+jintArray to_java(JNIEnv* env, std::pair<const int32_t*, size_t> input) {
+    auto output = env->NewIntArray(input.second);
+    env->SetIntArrayRegion(output, 0, input.second, input.first);
+    return output;
+}
+
+// The array inputs of the calls with a callback are copied into `arena` with a
+// single JNI call. The other calls borrow them through a critical region.
+void from_java(JNIEnv* env, jintArray input, Arena& arena, int32_t*& ptr, size_t& len) {
+    len = (size_t) env->GetArrayLength(input);
+    ptr = (int32_t*) arena.allocate(len * sizeof(int32_t), alignof(int32_t));
+    env->GetIntArrayRegion(input, 0, (jsize) len, (jint*) ptr);
+}
+
+// array of byte
+// -----------------------------------------------------------------------------
+void from_java(JNIEnv* env, jbyteArray input, Arena& arena, uint8_t*& ptr, size_t& len) {
+    len = (size_t) env->GetArrayLength(input);
+    ptr = (uint8_t*) arena.allocate(len, 1);
+    env->GetByteArrayRegion(input, 0, (jsize) len, (jbyte*) ptr);
+}
+
+// FfiResult
+// -----------------------------------------------------------------------------
+constexpr auto java_signature(tag<const FfiResult*>) { return signature("LFfiResult;"); }
+
+jobject to_java(JNIEnv* env, const FfiResult* input) {
+    auto output = new_java_object(env, cache.FfiResult.klass, cache.FfiResult.init);
+
+    env->SetIntField(output, cache.FfiResult.errorCode, input->error_code);
+    env->SetObjectField(output, cache.FfiResult.error, to_java(env, input->error));
+
+    return output;
+}
+
+// Key
+// -----------------------------------------------------------------------------
+constexpr auto java_signature(tag<const Key*>) { return signature("LKey;"); }
+
+void from_java(JNIEnv* env, jobject input, Key& output) {
+    auto j_bytes = (jbyteArray) env->GetObjectField(input, cache.Key.bytes);
+    env->GetByteArrayRegion(j_bytes, 0, 8, (jbyte*) &output.bytes);
+    env->DeleteLocalRef(j_bytes);
+}
+
+jobject to_java(JNIEnv* env, const Key* input) {
+    auto output = new_java_object(env, cache.Key.klass, cache.Key.init);
+
+    auto j_bytes = env->NewByteArray(8);
+    assert(j_bytes);
+
+    env->SetByteArrayRegion(j_bytes, 0, 8, (jbyte*) input->bytes);
+    env->SetObjectField(output, cache.Key.bytes, j_bytes);
+
+    return output;
+}
+
+// array of Key, packed (KeyArray)
+// -----------------------------------------------------------------------------
+struct PackedKeys {
+    const Key* ptr;
+    size_t len;
+};
+
+constexpr auto java_signature(tag<PackedKeys>) { return signature("LKeyArray;"); }
+
+jobject to_java(JNIEnv* env, PackedKeys input) {
+    auto size = (jsize) (input.len * sizeof(Key));
+
+    auto j_bytes = env->NewByteArray(size);
+    assert(j_bytes);
+
+    env->SetByteArrayRegion(j_bytes, 0, size, (const jbyte*) input.ptr);
+
+    auto output = env->NewObject(cache.KeyArray.klass, cache.KeyArray.init, j_bytes);
+    assert(output);
+
+    return output;
+}
+
+// The byte array of a KeyArray, whose length is a multiple of the key size.
+jbyteArray key_bytes(JNIEnv* env, jobject input, size_t& len) {
+    auto output = (jbyteArray) env->GetObjectField(input, cache.KeyArray.bytes);
+    len = (size_t) env->GetArrayLength(output) / sizeof(Key);
+
+    return output;
+}
+
+void from_java(JNIEnv* env, jobject input, Arena& arena, Key*& ptr, size_t& len) {
+    auto j_bytes = key_bytes(env, input, len);
+    ptr = (Key*) arena.allocate(len * sizeof(Key), alignof(Key));
+    env->GetByteArrayRegion(j_bytes, 0, (jsize) (len * sizeof(Key)), (jbyte*) ptr);
+    env->DeleteLocalRef(j_bytes);
+}
+
+// array of AppInfo, packed: one array per field
+// -----------------------------------------------------------------------------
+struct AppInfoIds {
+    const AppInfo* ptr;
+    size_t len;
+};
+
+struct AppInfoNames {
+    const AppInfo* ptr;
+    size_t len;
+};
+
+struct AppInfoKeys {
+    const AppInfo* ptr;
+    size_t len;
+};
+
+constexpr auto java_signature(tag<AppInfoIds>) { return signature("[I"); }
+constexpr auto java_signature(tag<AppInfoNames>) { return signature("[Ljava/lang/String;"); }
+constexpr auto java_signature(tag<AppInfoKeys>) { return signature("LKeyArray;"); }
+
+jintArray to_java(JNIEnv* env, AppInfoIds input) {
+    auto output = env->NewIntArray(input.len);
+    assert(output);
+
+    auto ids = (jint*) env->GetPrimitiveArrayCritical(output, nullptr);
+    for (size_t i = 0; i < input.len; ++i) {
+        ids[i] = input.ptr[i].id;
+    }
+    env->ReleasePrimitiveArrayCritical(output, ids, 0);
+
+    return output;
+}
+
+jobjectArray to_java(JNIEnv* env, AppInfoNames input) {
+    auto output = env->NewObjectArray(input.len, cache.String.klass, nullptr);
+    assert(output);
+
+    for (size_t i = 0; i < input.len; ++i) {
+        auto name = to_java(env, input.ptr[i].name);
+        env->SetObjectArrayElement(output, (jsize) i, name);
+        env->DeleteLocalRef(name);
+    }
+
+    return output;
+}
+
+jobject to_java(JNIEnv* env, AppInfoKeys input) {
+    auto size = (jsize) (input.len * sizeof(Key));
+
+    auto j_bytes = env->NewByteArray(size);
+    assert(j_bytes);
+
+    auto bytes = (Key*) env->GetPrimitiveArrayCritical(j_bytes, nullptr);
+    for (size_t i = 0; i < input.len; ++i) {
+        bytes[i] = input.ptr[i].key;
+    }
+    env->ReleasePrimitiveArrayCritical(j_bytes, bytes, 0);
+
+    auto output = env->NewObject(cache.KeyArray.klass, cache.KeyArray.init, j_bytes);
+    assert(output);
+
+    return output;
+}
+
+// AppInfo
+// -----------------------------------------------------------------------------
+constexpr auto java_signature(tag<const AppInfo*>) { return signature("LAppInfo;"); }
+
+// `output.name` is allocated in `arena`.
+void from_java(JNIEnv* env, jobject input, Arena& arena, AppInfo& output) {
+    output.id = env->GetIntField(input, cache.AppInfo.id);
+
+    auto j_name = (jstring) env->GetObjectField(input, cache.AppInfo.name);
+    from_java(env, j_name, arena, output.name);
+    env->DeleteLocalRef(j_name);
+
+    auto j_key = env->GetObjectField(input, cache.AppInfo.key);
+    from_java(env, j_key, output.key);
+    env->DeleteLocalRef(j_key);
+}
+
+void from_java(JNIEnv* env, jobjectArray input, Arena& arena, AppInfo*& ptr, size_t& len) {
+    len = (size_t) env->GetArrayLength(input);
+    ptr = (AppInfo*) arena.allocate(len * sizeof(AppInfo), alignof(AppInfo));
+
+    for (size_t i = 0; i < len; ++i) {
+        auto element = env->GetObjectArrayElement(input, (jsize) i);
+        from_java(env, element, arena, ptr[i]);
+        env->DeleteLocalRef(element);
+    }
+}
+
+jobject to_java(JNIEnv* env, const AppInfo* input) {
+    auto output = new_java_object(env, cache.AppInfo.klass, cache.AppInfo.init);
+
+    env->SetIntField(output, cache.AppInfo.id, to_java(env, input->id));
+    env->SetObjectField(output, cache.AppInfo.name, to_java(env, input->name));
+    env->SetObjectField(output, cache.AppInfo.key, to_java(env, &input->key));
+
+    return output;
+}
+
+// -----------------------------------------------------------------------------
+// Callbacks
+// -----------------------------------------------------------------------------
+
+template<typename... J>
+void upcall(JNIEnv* env, jobject cb, jmethodID method, uint64_t started, J... j_args) {
+    auto marshalled = backend_now_ns();
+    backend_record_callback_stat(STATS_MARSHAL, marshalled - started);
+
+    env->CallVoidMethod(cb, method, j_args...);
+
+    backend_record_callback_stat(STATS_UPCALL, backend_now_ns() - marshalled);
+}
+
+// The context of a callback is the `CallbackRegistry` handle of the Java
+// callback objects. Returns null if the handle is stale.
+jobject take_callback(JNIEnv* env, void* ctx, jint index) {
+    return env->CallStaticObjectMethod(cache.CallbackRegistry.klass,
+                                       cache.CallbackRegistry.take,
+                                       (jlong) (uintptr_t) ctx,
+                                       index);
+}
+
+void* to_context(jlong handle) {
+    return (void*) (uintptr_t) handle;
+}
+
+template<typename... T>
+void call_impl(const CallbackInterface<T...>& callback, jint index, void* ctx, const FfiResult* result, T... args) {
+    auto env = attach_current_thread();
+
+    // The backend threads never return to Java, so their local refs have to be
+    // released explicitly.
+    env->PushLocalFrame(16);
+
+    auto started = backend_now_ns();
+    auto cb = take_callback(env, ctx, index);
+
+    if (cb) {
+        upcall(env, cb, callback.call(env), started, to_java(env, result), to_java(env, args)...);
+    }
+
+    env->PopLocalFrame(nullptr);
+}
+
+// @trampolines@
+
+// -----------------------------------------------------------------------------
+// Wrappers
+// -----------------------------------------------------------------------------
+
+extern "C" {
+
+jint JNI_OnLoad(JavaVM* vm, void* reserved) {
+    jvm = vm;
+
+    JNIEnv* env = nullptr;
+    if (vm->GetEnv((void**) &env, JNI_VERSION_1_4) != JNI_OK) {
+        return JNI_ERR;
+    }
+
+    cache_init(env);
+    pthread_key_create(&env_key, detach_current_thread);
+
+    return JNI_VERSION_1_4;
+}
+
+void JNI_OnUnload(JavaVM* vm, void* reserved) {
+    JNIEnv* env = nullptr;
+    if (vm->GetEnv((void**) &env, JNI_VERSION_1_4) != JNI_OK) {
+        return;
+    }
+
+    cache_release(env);
+    pthread_key_delete(env_key);
+    jvm = nullptr;
+}
+
+// @wrappers@
+
+}
@@ -4,14 +4,11 @@ import java.util.Arrays;
 class Frontend {
     public static void main(String args[]) {
         AppInfo app = new AppInfo();
-        app.setId(1234);
-        app.setName("Unique-App");
+        app.id = 1234;
+        app.name = "Unique-App";
 
-        {
-            Key key = new Key();
-            key.setBytes(new byte[] { 1, 2, 3, 5, 7, 11, 13, 17 });
-            app.setKey(key);
-        }
+        app.key = new Key();
+        app.key.bytes = new byte[] { 1, 2, 3, 5, 7, 11, 13, 17 };
 
         NativeBindings.registerApp(app, (result) -> {
             System.out.println("- Java: registerApp()");
@@ -32,7 +29,7 @@ class Frontend {
         // ---
 
         NativeBindings.getAppKey(app, (result, res) -> {
-            System.out.println("- Java: getAppKey(): " + Arrays.toString(res.getBytes()));
+            System.out.println("- Java: getAppKey(): " + Arrays.toString(res.bytes));
         });
 
         // ---
@@ -46,7 +43,7 @@ class Frontend {
         NativeBindings.randomKeys((result, res) -> {
             System.out.println("- Java: randomKeys():");
             for (int i = 0; i < res.length; ++i) {
-                System.out.println("    " + i + ": " + Arrays.toString(res[i].getBytes()));
+                System.out.println("    " + i + ": " + Arrays.toString(res[i].bytes));
             }
         });
 
@@ -55,7 +52,7 @@ class Frontend {
         NativeBindings.getAppInfo(app, (result, id, name, key) -> {
             System.out.println("- Java: getAppInfo(): { id: " + id
                                + ", name: " + name
-                               + ", key: " + Arrays.toString(key.getBytes())
+                               + ", key: " + Arrays.toString(key.bytes)
                                + " }");
         });
 
@@ -66,9 +63,9 @@ class Frontend {
                 @Override
                 public void onConnect(FfiResult result, AppInfo app_info) {
                     System.out.println(
-                          "- Java: createAccount() [connect]: { id: " + app_info.getId()
-                        + ", name: " + app_info.getName()
-                        + ", key: " + Arrays.toString(app_info.getKey().getBytes())
+                          "- Java: createAccount() [connect]: { id: " + app_info.id
+                        + ", name: " + app_info.name
+                        + ", key: " + Arrays.toString(app_info.key.bytes)
                         + " }"
                     );
                 }
@@ -82,24 +79,24 @@ class Frontend {
 
         // ---
 
-        // TODO: this currently doesnt' work correctly - the callback gets called
-        // only once.
-        NativeBindings.createAccount2("locator2", "password2", (result, event) -> {
-            switch (event.getType()) {
-                case NativeBindings.CREATE_ACCOUNT_CONNECT:
-                    AppInfo app_info = event.getConnected().getApp_info();
-
-                    System.out.println(
-                          "- Java: createAccount2() [connect]: { id: " + app_info.getId()
-                        + ", name: " + app_info.getName()
-                        + ", key: " + Arrays.toString(app_info.getKey().getBytes())
-                        + " }"
-                    );
-
-                    break;
-                case NativeBindings.CREATE_ACCOUNT_DISCONNECT:
-                    System.out.println("- Java: createAccount2() [disconnect]");
-                    break;
+        NativeBindings.createAccount2("locator2", "password2", (result, events) -> {
+            for (CreateAccountEvent event : events) {
+                switch (event.type) {
+                    case CreateAccountEvent.CONNECT:
+                        AppInfo app_info = event.appInfo;
+
+                        System.out.println(
+                              "- Java: createAccount2() [connect]: { id: " + app_info.id
+                            + ", name: " + app_info.name
+                            + ", key: " + Arrays.toString(app_info.key.bytes)
+                            + " }"
+                        );
+
+                        break;
+                    case CreateAccountEvent.DISCONNECT:
+                        System.out.println("- Java: createAccount2() [disconnect]");
+                        break;
+                }
             }
         });
 
@@ -109,25 +106,25 @@ class Frontend {
         byte[] data2 = new byte[] { 1, 1, 1, 2, 1, 1, 2, 1 };
 
         NativeBindings.verifySignature(data1, (result) -> {
-            System.out.println("- Java: verifySignature(): " + result.getError());
+            System.out.println("- Java: verifySignature(): " + result.error);
         });
 
         NativeBindings.verifySignature(data2, (result) -> {
-            System.out.println("- Java: verifySignature(): " + result.getError());
+            System.out.println("- Java: verifySignature(): " + result.error);
         });
 
         // ---
 
         Key key0 = new Key();
-        key0.setBytes(new byte[] { 0, 0, 0, 0, 0, 0, 0, 0 });
+        key0.bytes = new byte[] { 0, 0, 0, 0, 0, 0, 0, 0 };
 
         Key key1 = new Key();
-        key1.setBytes(new byte[] { 1, 1, 1, 1, 1, 1, 1, 1 });
+        key1.bytes = new byte[] { 1, 1, 1, 1, 1, 1, 1, 1 };
 
         Key key2 = new Key();
-        key2.setBytes(new byte[] { 2, 2, 2, 2, 2, 2, 2, 2 });
+        key2.bytes = new byte[] { 2, 2, 2, 2, 2, 2, 2, 2 };
 
-        Key[] keys = new Key[] { key0, key1, key2 };
+        KeyArray keys = KeyArray.of(key0, key1, key2);
 
         NativeBindings.verifyKeys(keys, (result) -> {
             System.out.println("- Java: verifyKeys()");
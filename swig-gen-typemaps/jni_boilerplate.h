@@ -4,121 +4,414 @@
 #include <string>
 #include <cassert>
 #include <jni.h>
+#include <pthread.h>
 
 #include "backend.h"
 
 static JavaVM* jvm = nullptr;
 
+// Holds the `JNIEnv*` of the native threads we attached to the JVM. The thread
+// gets attached on its first callback and detached by the key destructor when
+// it exits.
+static pthread_key_t env_key;
+
+static void detach_current_thread(void*) {
+    if (jvm) {
+        jvm->DetachCurrentThread();
+    }
+}
+
+static JNIEnv* attach_current_thread() {
+    JNIEnv* env = (JNIEnv*) pthread_getspecific(env_key);
+    if (env) {
+        return env;
+    }
+
+    // Threads created by the JVM (or attached by someone else) are left alone.
+    if (jvm->GetEnv((void**) &env, JNI_VERSION_1_4) == JNI_OK) {
+        return env;
+    }
+
+    jvm->AttachCurrentThreadAsDaemon((void**) &env, nullptr);
+    assert(env);
+
+    pthread_setspecific(env_key, env);
+    return env;
+}
+
+// The value classes (see `values`), which the structs are copied into and out
+// of instead of being wrapped in SWIG proxies. Resolved once in `JNI_OnLoad`:
+// the `FindClass` of the backend threads can't see the application classes.
+static struct {
+    struct {
+        jclass klass;
+        jmethodID init;
+        jfieldID bytes;
+    } Key;
+
+    struct {
+        jclass klass;
+        jmethodID init;
+        jfieldID id;
+        jfieldID name;
+        jfieldID key;
+    } AppInfo;
+
+    struct {
+        jclass klass;
+        jmethodID init;
+        jfieldID errorCode;
+        jfieldID error;
+    } FfiResult;
+
+    struct {
+        jclass klass;
+        jmethodID init;
+        jfieldID type;
+        jfieldID appInfo;
+    } CreateAccountEvent;
+} values;
+
+static jclass find_class(JNIEnv* env, const char* name) {
+    jclass local = env->FindClass(name);
+    assert(local);
+
+    jclass global = (jclass) env->NewGlobalRef(local);
+    env->DeleteLocalRef(local);
+
+    return global;
+}
+
+static void values_init(JNIEnv* env) {
+    values.Key.klass = find_class(env, "Key");
+    values.Key.init = env->GetMethodID(values.Key.klass, "<init>", "()V");
+    values.Key.bytes = env->GetFieldID(values.Key.klass, "bytes", "[B");
+
+    values.AppInfo.klass = find_class(env, "AppInfo");
+    values.AppInfo.init = env->GetMethodID(values.AppInfo.klass, "<init>", "()V");
+    values.AppInfo.id = env->GetFieldID(values.AppInfo.klass, "id", "I");
+    values.AppInfo.name = env->GetFieldID(values.AppInfo.klass, "name", "Ljava/lang/String;");
+    values.AppInfo.key = env->GetFieldID(values.AppInfo.klass, "key", "LKey;");
+
+    values.FfiResult.klass = find_class(env, "FfiResult");
+    values.FfiResult.init = env->GetMethodID(values.FfiResult.klass, "<init>", "()V");
+    values.FfiResult.errorCode = env->GetFieldID(values.FfiResult.klass, "errorCode", "I");
+    values.FfiResult.error = env->GetFieldID(values.FfiResult.klass, "error", "Ljava/lang/String;");
+
+    values.CreateAccountEvent.klass = find_class(env, "CreateAccountEvent");
+    values.CreateAccountEvent.init = env->GetMethodID(values.CreateAccountEvent.klass, "<init>", "()V");
+    values.CreateAccountEvent.type = env->GetFieldID(values.CreateAccountEvent.klass, "type", "I");
+    values.CreateAccountEvent.appInfo = env->GetFieldID(values.CreateAccountEvent.klass,
+                                                        "appInfo",
+                                                        "LAppInfo;");
+}
+
+static void values_release(JNIEnv* env) {
+    jclass classes[] = {
+        values.Key.klass,
+        values.AppInfo.klass,
+        values.FfiResult.klass,
+        values.CreateAccountEvent.klass,
+    };
+
+    for (auto klass : classes) {
+        if (klass) {
+            env->DeleteGlobalRef(klass);
+        }
+    }
+}
+
+// The callback interfaces (see `callbacks`), resolved with the value classes.
+// `Callback1` is generic, so its argument is erased to `Object`.
+static struct {
+    struct {
+        jclass klass;
+        jmethodID call;
+    } Callback0;
+
+    struct {
+        jclass klass;
+        jmethodID call;
+    } Callback1;
+
+    struct {
+        jclass klass;
+        jmethodID call;
+    } CallbackInt;
+
+    struct {
+        jclass klass;
+        jmethodID call;
+    } CallbackIntStringKey;
+
+    struct {
+        jclass klass;
+        jmethodID onConnect;
+        jmethodID onDisconnect;
+    } CreateAccountHandler;
+} callbacks;
+
+static void callbacks_init(JNIEnv* env) {
+    callbacks.Callback0.klass = find_class(env, "Callback0");
+    callbacks.Callback0.call = env->GetMethodID(callbacks.Callback0.klass, "call", "(LFfiResult;)V");
+    assert(callbacks.Callback0.call);
+
+    callbacks.Callback1.klass = find_class(env, "Callback1");
+    callbacks.Callback1.call = env->GetMethodID(callbacks.Callback1.klass,
+                                                "call",
+                                                "(LFfiResult;Ljava/lang/Object;)V");
+    assert(callbacks.Callback1.call);
+
+    callbacks.CallbackInt.klass = find_class(env, "CallbackInt");
+    callbacks.CallbackInt.call = env->GetMethodID(callbacks.CallbackInt.klass, "call", "(LFfiResult;I)V");
+    assert(callbacks.CallbackInt.call);
+
+    callbacks.CallbackIntStringKey.klass = find_class(env, "CallbackIntStringKey");
+    callbacks.CallbackIntStringKey.call = env->GetMethodID(callbacks.CallbackIntStringKey.klass,
+                                                           "call",
+                                                           "(LFfiResult;ILjava/lang/String;LKey;)V");
+    assert(callbacks.CallbackIntStringKey.call);
+
+    callbacks.CreateAccountHandler.klass = find_class(env, "CreateAccountHandler");
+    callbacks.CreateAccountHandler.onConnect = env->GetMethodID(callbacks.CreateAccountHandler.klass,
+                                                                "onConnect",
+                                                                "(LFfiResult;LAppInfo;)V");
+    callbacks.CreateAccountHandler.onDisconnect = env->GetMethodID(callbacks.CreateAccountHandler.klass,
+                                                                   "onDisconnect",
+                                                                   "(LFfiResult;)V");
+    assert(callbacks.CreateAccountHandler.onConnect && callbacks.CreateAccountHandler.onDisconnect);
+}
+
+static void callbacks_release(JNIEnv* env) {
+    jclass classes[] = {
+        callbacks.Callback0.klass,
+        callbacks.Callback1.klass,
+        callbacks.CallbackInt.klass,
+        callbacks.CallbackIntStringKey.klass,
+        callbacks.CreateAccountHandler.klass,
+    };
+
+    for (auto klass : classes) {
+        if (klass) {
+            env->DeleteGlobalRef(klass);
+        }
+    }
+}
+
 // This is called when `loadLibrary` is called on the Java side.
 extern "C"
 jint JNI_OnLoad(JavaVM* vm, void* reserved) {
     jvm = vm;
+
+    JNIEnv* env = nullptr;
+    if (vm->GetEnv((void**) &env, JNI_VERSION_1_4) != JNI_OK) {
+        return JNI_ERR;
+    }
+
+    values_init(env);
+    callbacks_init(env);
+    pthread_key_create(&env_key, detach_current_thread);
     // TODO: not sure about this version.
     return JNI_VERSION_1_4;
 }
 
-// Wrap the C struct in the Java wrapper.
-template<typename T>
-jobject wrap(JNIEnv* env, const char* class_name, const T* input) {
-    jclass klass = env->FindClass(class_name);
-    assert(klass);
+extern "C"
+void JNI_OnUnload(JavaVM* vm, void* reserved) {
+    JNIEnv* env = nullptr;
+    if (vm->GetEnv((void**) &env, JNI_VERSION_1_4) == JNI_OK) {
+        values_release(env);
+        callbacks_release(env);
+    }
 
-    // Here we exploit the fact that all SWIG generated struct have constructor
-    // which takes a `long` (pointer to the C struct) and a `boolean` (whether the C
-    // struct is owner or not).
-    jmethodID constructor = env->GetMethodID(klass, "<init>", "(JZ)V");
-    assert(constructor);
+    pthread_key_delete(env_key);
+    jvm = nullptr;
+}
+
+// Conversions of the value types. The C strings are copied into the
+// `std::string`s, which must outlive the struct.
 
-    jobject output = env->NewObject(klass, constructor, (jlong) input, JNI_FALSE);
+static jobject new_value(JNIEnv* env, jclass klass, jmethodID init) {
+    jobject output = env->NewObject(klass, init);
     assert(output);
 
     return output;
 }
 
-// Helper
-template<typename... F>
-void call_cb(void* ctx,
-             const FfiResult* result,
-             const char* cb_class,
-             const char* cb_method,
-             const char* args_sig = "",
-             F... wrap_args)
-{
-    JNIEnv* env = nullptr;
-    jvm->AttachCurrentThreadAsDaemon((void**) &env, nullptr);
+static jobject to_java(JNIEnv* env, const Key* input) {
+    jobject output = new_value(env, values.Key.klass, values.Key.init);
+
+    jbyteArray bytes = env->NewByteArray(sizeof(input->bytes));
+    env->SetByteArrayRegion(bytes, 0, sizeof(input->bytes), input->bytes);
+    env->SetObjectField(output, values.Key.bytes, bytes);
+    env->DeleteLocalRef(bytes);
+
+    return output;
+}
+
+static void from_java(JNIEnv* env, jobject input, Key& output) {
+    jbyteArray bytes = (jbyteArray) env->GetObjectField(input, values.Key.bytes);
+    env->GetByteArrayRegion(bytes, 0, sizeof(output.bytes), output.bytes);
+    env->DeleteLocalRef(bytes);
+}
+
+static jstring to_java(JNIEnv* env, const char* input) {
+    return input ? env->NewStringUTF(input) : nullptr;
+}
+
+static void from_java(JNIEnv* env, jstring input, std::string& output) {
+    output.clear();
+
+    if (input) {
+        const char* chars = env->GetStringUTFChars(input, nullptr);
+        output = chars;
+        env->ReleaseStringUTFChars(input, chars);
+    }
+}
+
+static jobject to_java(JNIEnv* env, const AppInfo* input) {
+    jobject output = new_value(env, values.AppInfo.klass, values.AppInfo.init);
+
+    jstring name = to_java(env, input->name);
+    jobject key = to_java(env, &input->key);
+
+    env->SetIntField(output, values.AppInfo.id, input->id);
+    env->SetObjectField(output, values.AppInfo.name, name);
+    env->SetObjectField(output, values.AppInfo.key, key);
+
+    env->DeleteLocalRef(name);
+    env->DeleteLocalRef(key);
+
+    return output;
+}
+
+static void from_java(JNIEnv* env, jobject input, AppInfo& output, std::string& name) {
+    output.id = env->GetIntField(input, values.AppInfo.id);
+
+    jstring j_name = (jstring) env->GetObjectField(input, values.AppInfo.name);
+    from_java(env, j_name, name);
+    output.name = (char*) name.c_str();
+    env->DeleteLocalRef(j_name);
+
+    jobject key = env->GetObjectField(input, values.AppInfo.key);
+    from_java(env, key, output.key);
+    env->DeleteLocalRef(key);
+}
+
+static jobject to_java(JNIEnv* env, const FfiResult* input) {
+    jobject output = new_value(env, values.FfiResult.klass, values.FfiResult.init);
+
+    jstring error = to_java(env, input->error);
+
+    env->SetIntField(output, values.FfiResult.errorCode, input->error_code);
+    env->SetObjectField(output, values.FfiResult.error, error);
+
+    env->DeleteLocalRef(error);
+
+    return output;
+}
+
+static void from_java(JNIEnv* env, jobject input, FfiResult& output, std::string& error) {
+    output.error_code = env->GetIntField(input, values.FfiResult.errorCode);
+
+    jstring j_error = (jstring) env->GetObjectField(input, values.FfiResult.error);
+    from_java(env, j_error, error);
+    output.error = j_error ? (char*) error.c_str() : nullptr;
+    env->DeleteLocalRef(j_error);
+}
 
-    jobject obj = (jobject) ctx;
+static jobject to_java(JNIEnv* env, const CreateAccountEvent* input) {
+    jobject output = new_value(env, values.CreateAccountEvent.klass, values.CreateAccountEvent.init);
 
-    const jclass callbackClass = env->FindClass(cb_class);
-    assert(callbackClass);
+    env->SetIntField(output, values.CreateAccountEvent.type, input->type);
 
-    std::string sig("(LFfiResult;");
-    sig.append(args_sig);
-    sig.append(")V");
+    if (input->type == CREATE_ACCOUNT_CONNECT) {
+        jobject app_info = to_java(env, &input->connected.app_info);
+        env->SetObjectField(output, values.CreateAccountEvent.appInfo, app_info);
+        env->DeleteLocalRef(app_info);
+    }
+
+    return output;
+}
+
+template<typename T>
+jobjectArray to_java_array(JNIEnv* env, jclass klass, const T* ptr, size_t len) {
+    jobjectArray output = env->NewObjectArray(len, klass, nullptr);
+    assert(output);
+
+    for (size_t i = 0; i < len; ++i) {
+        jobject element = to_java(env, ptr + i);
+        env->SetObjectArrayElement(output, i, element);
+        env->DeleteLocalRef(element);
+    }
+
+    return output;
+}
+
+// Helper. Keeps the global ref to the callback, for callbacks called several
+// times.
+template<typename... F>
+void invoke_cb(void* ctx, const FfiResult* result, jmethodID method, F... wrap_args) {
+    JNIEnv* env = attach_current_thread();
 
-    const jmethodID method = env->GetMethodID(callbackClass, cb_method, sig.c_str());
-    assert(method);
+    // The backend threads never return to Java, so the local refs of each
+    // upcall are released with its frame.
+    env->PushLocalFrame(16);
 
     // TODO: handle exceptions thrown from inside the callback.
 
-    env->CallVoidMethod(obj,
+    env->CallVoidMethod((jobject) ctx,
                         method,
-                        wrap(env, "FfiResult", result),
+                        to_java(env, result),
                         wrap_args(env)...);
 
-    env->DeleteGlobalRef(obj);
+    env->PopLocalFrame(nullptr);
+}
+
+// Helper
+template<typename... F>
+void call_cb(void* ctx, const FfiResult* result, jmethodID method, F... wrap_args) {
+    invoke_cb(ctx, result, method, wrap_args...);
+    attach_current_thread()->DeleteGlobalRef((jobject) ctx);
 }
 
 // Helper
 template<typename T>
-void call_cb_object(void* ctx, const FfiResult* result, const char* name, const T* arg) {
-    call_cb(ctx, result, "Callback1", "call", "Ljava/lang/Object;", [=](auto env) {
-        return wrap(env, name, arg);
+void call_cb_value(void* ctx, const FfiResult* result, const T* arg) {
+    call_cb(ctx, result, callbacks.Callback1.call, [=](auto env) {
+        return to_java(env, arg);
     });
 }
 
 // Helper
 template<typename T>
-void call_cb_object_array(void* ctx, const FfiResult* result, const char* name, const T* ptr, size_t len) {
-    call_cb(ctx, result, "Callback1", "call", "Ljava/lang/Object;", [=](auto env) {
-        jclass elementClass = env->FindClass(name);
-        assert(elementClass);
-
-        auto array = env->NewObjectArray(len, elementClass, 0);
-        assert(array);
-
-        for (auto i = 0; i < len; ++i) {
-            env->SetObjectArrayElement(array, i, wrap(env, name, ptr + i));
-        }
-
-        return array;
+void call_cb_value_array(void* ctx, const FfiResult* result, jclass klass, const T* ptr, size_t len) {
+    call_cb(ctx, result, callbacks.Callback1.call, [=](auto env) {
+        return to_java_array(env, klass, ptr, len);
     });
 }
 
-
-
 void call_cb_void(void* ctx, const FfiResult* result) {
-    call_cb(ctx, result, "Callback0", "call");
+    call_cb(ctx, result, callbacks.Callback0.call);
 }
 
 void call_cb_i32(void* ctx, const FfiResult* result, int32_t arg) {
-    call_cb(ctx, result, "CallbackInt", "call", "I", [=](auto env) {
+    call_cb(ctx, result, callbacks.CallbackInt.call, [=](auto env) {
         return (jint) arg;
     });
 }
 
 void call_cb_string(void* ctx, const FfiResult* result, const char* arg) {
-    call_cb(ctx, result, "Callback1", "call", "Ljava/lang/Object;", [=](auto env) {
+    call_cb(ctx, result, callbacks.Callback1.call, [=](auto env) {
         return env->NewStringUTF(arg);
     });
 }
 
 void call_cb_Key(void* ctx, const FfiResult* result, const Key* arg) {
-    call_cb_object(ctx, result, "Key", arg);
+    call_cb_value(ctx, result, arg);
 }
 
 void call_cb_i32_array(void* ctx, const FfiResult* result, const int32_t* ptr, size_t len) {
-    call_cb(ctx, result, "Callback1", "call", "Ljava/lang/Object;", [=](auto env) {
+    call_cb(ctx, result, callbacks.Callback1.call, [=](auto env) {
         auto array = env->NewIntArray(len);
         env->SetIntArrayRegion(array, 0, len, ptr);
         return array;
@@ -126,7 +419,7 @@ void call_cb_i32_array(void* ctx, const FfiResult* result, const int32_t* ptr, s
 }
 
 void call_cb_Key_array(void* ctx, const FfiResult* result, const Key* ptr, size_t len) {
-    call_cb_object_array(ctx, result, "Key", ptr, len);
+    call_cb_value_array(ctx, result, values.Key.klass, ptr, len);
 }
 
 void call_cb_i32_string_Key(void* ctx,
@@ -136,49 +429,39 @@ void call_cb_i32_string_Key(void* ctx,
                             const Key* arg2)
 {
     call_cb(
-        ctx, result, "CallbackIntStringKey", "call", "ILjava/lang/String;LKey;",
+        ctx, result, callbacks.CallbackIntStringKey.call,
         [=](auto env) { return (jint) arg0; },
         [=](auto env) { return env->NewStringUTF(arg1); },
-        [=](auto env) { return wrap(env, "Key", arg2); }
+        [=](auto env) { return to_java(env, arg2); }
     );
 }
 
-void call_cb_CreateAccountEvent(void* ctx, const FfiResult* result, const CreateAccountEvent* arg) {
-    call_cb_object(ctx, result, "CreateAccountEvent", arg);
+// Called once per batch of events, with the same callback for the whole
+// session, so its global ref is only deleted after the last batch.
+void call_cb_CreateAccountEvent_array(void* ctx,
+                                      const FfiResult* result,
+                                      const CreateAccountEvent* ptr,
+                                      size_t len)
+{
+    bool last = result->error_code != 0 || (len > 0 && ptr[len - 1].type == CREATE_ACCOUNT_DISCONNECT);
+
+    invoke_cb(ctx, result, callbacks.Callback1.call, [=](auto env) {
+        return to_java_array(env, values.CreateAccountEvent.klass, ptr, len);
+    });
+
+    if (last) {
+        attach_current_thread()->DeleteGlobalRef((jobject) ctx);
+    }
 }
 
+// Both callbacks of `create_account` share the handler. Disconnect always comes
+// last, even for a rejected call, so only it deletes the global ref.
 void call_create_account_connect_cb(void* ctx, const FfiResult* result, const AppInfo* app_info) {
-    call_cb(ctx, result, "CreateAccountHandler", "onConnect", "LAppInfo;",
-            [=](auto env) { return wrap(env, "AppInfo", app_info); });
+    invoke_cb(ctx, result, callbacks.CreateAccountHandler.onConnect, [=](auto env) {
+        return to_java(env, app_info);
+    });
 }
 
 void call_create_account_disconnect_cb(void* ctx, const FfiResult* result) {
-    call_cb(ctx, result, "CreateAccountHandler", "onDisconnect");
-}
-
-template<typename T>
-void copy_object_array(const char* class_name, JNIEnv* env, jobjectArray array, T*& o_ptr, size_t& o_len) {
-    jclass klass = env->FindClass(class_name);
-    assert(klass);
-
-    std::string sig("(L");
-    sig.append(class_name);
-    sig.append(";)J");
-
-    jmethodID method = env->GetStaticMethodID(klass, "getCPtr", sig.c_str());
-    assert(method);
-
-    size_t len = env->GetArrayLength(array);
-
-    auto temp = new T[len];
-
-    for (size_t i = 0; i < len; ++i) {
-        auto j_object = env->GetObjectArrayElement(array, i);
-        auto c_object = (T*) env->CallStaticLongMethod(klass, method, j_object);
-
-        temp[i] = *c_object;
-    }
-
-    o_ptr = temp;
-    o_len = len;
+    call_cb(ctx, result, callbacks.CreateAccountHandler.onDisconnect);
 }
@@ -13,6 +13,44 @@
 // Handling of arrays
 %include "java/arrays_java.i"
 
+// Value types: plain Java classes (see `values`), copied field by field when
+// they cross the boundary, so reading them from Java doesn't call into native
+// code, nor into memory that may be gone by then. The callbacks convert them
+// with the same `to_java` (see `jni_boilerplate.h`).
+%define VALUE(type)
+  %ignore type;
+
+  %typemap(jni)    const type* "jobject";
+  %typemap(jstype) const type* "type";
+  %typemap(jtype)  const type* "type";
+  %typemap(javain) const type* "$javainput";
+%enddef
+
+VALUE(Key)
+VALUE(AppInfo)
+VALUE(FfiResult)
+VALUE(CreateAccountEvent)
+
+// Only nested in `CreateAccountEvent`, which has an `appInfo` instead.
+%ignore CreateAccountConnect;
+%ignore CreateAccountDisconnect;
+
+%typemap(in) const Key* (Key temp) {
+  from_java(jenv, $input, temp);
+  $1 = &temp;
+}
+
+// The strings are held by the `std::string`s for the duration of the call.
+%typemap(in) const AppInfo* (AppInfo temp, std::string name) {
+  from_java(jenv, $input, temp, name);
+  $1 = &temp;
+}
+
+%typemap(in) const FfiResult* (FfiResult temp, std::string error) {
+  from_java(jenv, $input, temp, error);
+  $1 = &temp;
+}
+
 %define CALLBACK(signature, java_type)
   %typemap(jni)    (void* ctx, cb_ ## signature ## _t o_cb) "jobject";
   %typemap(jstype) (void* ctx, cb_ ## signature ## _t o_cb) "java_type";
@@ -28,14 +66,14 @@
 %enddef
 
 // Single callback
-CALLBACK(void,               Callback0)
-CALLBACK(i32,                CallbackInt)
-CALLBACK(i32_array,          Callback1<int[]>)
-CALLBACK(string,             Callback1<String>)
-CALLBACK(Key,                Callback1<Key>)
-CALLBACK(Key_array,          Callback1<Key[]>)
-CALLBACK(CreateAccountEvent, Callback1<CreateAccountEvent>)
-CALLBACK(i32_string_Key,     CallbackIntStringKey)
+CALLBACK(void,                     Callback0)
+CALLBACK(i32,                      CallbackInt)
+CALLBACK(i32_array,                Callback1<int[]>)
+CALLBACK(string,                   Callback1<String>)
+CALLBACK(Key,                      Callback1<Key>)
+CALLBACK(Key_array,                Callback1<Key[]>)
+CALLBACK(CreateAccountEvent_array, Callback1<CreateAccountEvent[]>)
+CALLBACK(i32_string_Key,           CallbackIntStringKey)
 
 // Two callbacks
 %typemap(jni)    (void* ctx, cb_AppInfo_t o_connect_cb, cb_void_t o_disconnect_cb) "jobject";
@@ -53,18 +91,23 @@ CALLBACK(i32_string_Key,     CallbackIntStringKey)
 // Array of uint8_t
 %apply(char *STRING, size_t LENGTH) { (const uint8_t* ptr, size_t len) };
 
-// Array of Key
-%typemap(jni)     (const Key* ptr, size_t len) "jobjectArray"
-%typemap(jtype)   (const Key* ptr, size_t len) "Key[]"
-%typemap(jstype)  (const Key* ptr, size_t len) "Key[]"
-%typemap(javain)  (const Key* ptr, size_t len) "$javainput"
+// Array of Key: a `KeyArray`, whose direct buffer is passed in place. The
+// functions taking one copy the keys before returning. The slice starts at the
+// buffer's position and ends at its limit.
+%typemap(jni)    (const Key* ptr, size_t len) "jobject"
+%typemap(jtype)  (const Key* ptr, size_t len) "java.nio.ByteBuffer"
+%typemap(jstype) (const Key* ptr, size_t len) "KeyArray"
+%typemap(javain) (const Key* ptr, size_t len) "$javainput.buffer.slice()"
 
-%typemap(in)      (const Key* ptr, size_t len) {
-  copy_object_array<Key>("Key", jenv, $input, $1, $2);
-}
+%typemap(in) (const Key* ptr, size_t len) {
+  $1 = (Key*) jenv->GetDirectBufferAddress($input);
 
-%typemap(freearg) (const Key* ptr, size_t len) {
-  delete $1;
+  if (!$1) {
+    SWIG_JavaThrowException(jenv, SWIG_JavaIllegalArgumentException, "the KeyArray buffer must be direct");
+    return $null;
+  }
+
+  $2 = (size_t) jenv->GetDirectBufferCapacity($input) / sizeof(Key);
 }
 
 // Load the DLL automatically
@@ -75,8 +118,11 @@ CALLBACK(i32_string_Key,     CallbackIntStringKey)
 %}
 
 // We can use Java naming convention:
+%rename(backendInit)     backend_init;
+%rename(backendShutdown) backend_shutdown;
 %rename(createAccount)   create_account;
 %rename(createAccount2)  create_account_2;
+%rename(findInvalidKeys) find_invalid_keys;
 %rename(getAppId)        get_app_id;
 %rename(getAppInfo)      get_app_info;
 %rename(getAppKey)       get_app_key;
@@ -87,4 +133,26 @@ CALLBACK(i32_string_Key,     CallbackIntStringKey)
 %rename(verifyKeys)      verify_keys;
 %rename(verifySignature) verify_signature;
 
+%rename(verifySignatureBegin)  verify_signature_begin;
+%rename(verifySignatureUpdate) verify_signature_update;
+%rename(verifySignatureFinish) verify_signature_finish;
+%rename(verifySignatureFile)   verify_signature_file;
+%rename(verifyKeysFile)        verify_keys_file;
+
+%rename(setLimits)          backend_set_limits;
+%rename(setAdmissionPolicy) backend_set_admission_policy;
+%rename(getAdmission)       backend_get_admission;
+
+// The borrowed input must outlive the call, which the array typemaps can't
+// guarantee.
+%ignore verify_signature_borrowed;
+
+// No typemaps for output buffers yet.
+%ignore random_numbers_fill;
+%ignore random_keys_fill;
+
+// No typemaps for input arrays of AppInfo yet.
+%ignore register_apps;
+%ignore get_app_infos;
+
 %include "backend.h"
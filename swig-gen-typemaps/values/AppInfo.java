@@ -0,0 +1,5 @@
+public class AppInfo {
+    public int id;
+    public String name;
+    public Key key;
+}
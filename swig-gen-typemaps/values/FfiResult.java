@@ -0,0 +1,9 @@
+public class FfiResult {
+    // The call was rejected because too many calls are in flight.
+    public static final int ERROR_OVERLOADED = -20;
+    // The input file of a `*File` call couldn't be opened or mapped.
+    public static final int ERROR_FILE = -21;
+
+    public int errorCode;
+    public String error;
+}
@@ -0,0 +1,5 @@
+public class Key {
+    public static final int SIZE = 8;
+
+    public byte[] bytes;
+}
@@ -0,0 +1,45 @@
+import java.nio.ByteBuffer;
+
+// Array of keys packed into a single direct buffer, `Key.SIZE` bytes per key.
+// The natives read the buffer in place, so passing it takes the same number of
+// JNI calls whatever its size. It can be filled in bulk through `buffer`. Only
+// the keys between its position and its limit are passed, so rewind it after
+// relative puts.
+public class KeyArray {
+    public final ByteBuffer buffer;
+
+    public KeyArray(int size) {
+        this.buffer = ByteBuffer.allocateDirect(size * Key.SIZE);
+    }
+
+    public static KeyArray of(Key... keys) {
+        KeyArray output = new KeyArray(keys.length);
+
+        for (int i = 0; i < keys.length; ++i) {
+            output.set(i, keys[i]);
+        }
+
+        return output;
+    }
+
+    public int size() {
+        return buffer.capacity() / Key.SIZE;
+    }
+
+    public Key get(int index) {
+        Key key = new Key();
+        key.bytes = new byte[Key.SIZE];
+        at(index).get(key.bytes);
+        return key;
+    }
+
+    public void set(int index, Key key) {
+        at(index).put(key.bytes, 0, Key.SIZE);
+    }
+
+    private ByteBuffer at(int index) {
+        ByteBuffer output = buffer.duplicate();
+        output.position(index * Key.SIZE);
+        return output;
+    }
+}